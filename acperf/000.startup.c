@@ -0,0 +1,30 @@
+/**
+ * @file      000.startup.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ * @brief     Empty program: its run time is the start-up and shut-down
+ *            time of the simulator.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+/* The file begin.h is included if compiler flag -DBEGINCODE is used */
+#ifdef BEGINCODE
+#include "begin.h"
+#endif
+
+int main() {
+  return 0;
+}
+
+/* The file end.h is included if compiler flag -DENDCODE is used */
+#ifdef ENDCODE
+#include "end.h"
+#endif
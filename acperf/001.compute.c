@@ -0,0 +1,84 @@
+/**
+ * @file      001.compute.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ * @brief     Compute-bound kernel: bitwise CRC-32, integer matrix
+ *            multiplication and a multiply-heavy hash, on data that
+ *            fits in a few cache lines.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+/* The file begin.h is included if compiler flag -DBEGINCODE is used */
+#ifdef BEGINCODE
+#include "begin.h"
+#endif
+
+#ifndef SCALE
+#define SCALE 1000
+#endif
+
+#define N 16
+
+unsigned int crc32(const unsigned char *p, int len, unsigned int crc) {
+  int i, k;
+
+  crc = ~crc;
+  for (i = 0; i < len; i++) {
+    crc ^= p[i];
+    for (k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+int main() {
+
+  static unsigned char data[1024];
+  static int a[N][N], b[N][N], c[N][N];
+  unsigned int crc = 0, hash = 2166136261u, seed = 1;
+  int iter, i, j, k;
+
+  for (i = 0; i < 1024; i++) {
+    seed = seed * 1103515245u + 12345u;
+    data[i] = seed >> 16;
+  }
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++) {
+      a[i][j] = i - j;
+      b[i][j] = i * j + 1;
+    }
+
+  for (iter = 0; iter < SCALE; iter++) {
+    crc = crc32(data, 1024, crc);
+
+    for (i = 0; i < N; i++)
+      for (j = 0; j < N; j++) {
+        int s = 0;
+        for (k = 0; k < N; k++)
+          s += a[i][k] * b[k][j];
+        c[i][j] = s;
+      }
+    a[iter % N][(iter * 7) % N] = c[(iter * 3) % N][iter % N] & 0xff;
+
+    for (i = 0; i < 1024; i++)
+      hash = (hash ^ data[i]) * 16777619u;
+  }
+
+  /* Checksums of the default SCALE */
+  if (SCALE == 1000 && (crc != 0xed2d30c9u || hash != 0xbf3cc6f5u || c[5][11] != -3476))
+    return 1;
+  return 0;
+}
+
+/* The file end.h is included if compiler flag -DENDCODE is used */
+#ifdef ENDCODE
+#include "end.h"
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file      002.memory.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ * @brief     Memory-bound kernel: pointer chasing through a random cycle
+ *            over 1 MB, then streaming copies and strided sums over
+ *            256 KB buffers.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+/* The file begin.h is included if compiler flag -DBEGINCODE is used */
+#ifdef BEGINCODE
+#include "begin.h"
+#endif
+
+#ifndef SCALE
+#define SCALE 32
+#endif
+
+#define CHASE_WORDS (1 << 18)
+#define STREAM_WORDS (1 << 16)
+
+static unsigned int next[CHASE_WORDS];
+static unsigned int src[STREAM_WORDS], dst[STREAM_WORDS];
+
+int main() {
+
+  unsigned int seed = 7, p, sum = 0;
+  int iter, i, stride;
+
+  /* Sattolo's shuffle gives a single cycle through every word */
+  for (i = 0; i < CHASE_WORDS; i++)
+    next[i] = i;
+  for (i = CHASE_WORDS - 1; i > 0; i--) {
+    unsigned int j, t;
+    seed = seed * 1103515245u + 12345u;
+    j = (seed >> 8) % i;
+    t = next[i]; next[i] = next[j]; next[j] = t;
+  }
+  for (i = 0; i < STREAM_WORDS; i++)
+    src[i] = i * 2654435761u;
+
+  for (iter = 0; iter < SCALE; iter++) {
+    p = iter;
+    for (i = 0; i < CHASE_WORDS; i++)
+      p = next[p];
+    sum += p;
+
+    for (i = 0; i < STREAM_WORDS; i++)
+      dst[i] = src[i] + iter;
+    for (stride = 1; stride <= 64; stride <<= 1)
+      for (i = 0; i < STREAM_WORDS; i += stride)
+        sum += dst[i];
+  }
+
+  /* Checksum of the default SCALE */
+  if (SCALE == 32 && sum != 0x866841f0u)
+    return 1;
+  return 0;
+}
+
+/* The file end.h is included if compiler flag -DENDCODE is used */
+#ifdef ENDCODE
+#include "end.h"
+#endif
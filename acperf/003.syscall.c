@@ -0,0 +1,65 @@
+/**
+ * @file      003.syscall.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ * @brief     System call heavy kernel: many small writes, seeks and reads
+ *            on a scratch file, with little computation between them.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+/* The file begin.h is included if compiler flag -DBEGINCODE is used */
+#ifdef BEGINCODE
+#include "begin.h"
+#endif
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef SCALE
+#define SCALE 20000
+#endif
+
+int main() {
+
+  unsigned char buf[16], back[16];
+  unsigned int sum = 0;
+  int fd, i, k;
+
+  fd = open("003.syscall.tmp", O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return 1;
+
+  for (i = 0; i < SCALE; i++) {
+    for (k = 0; k < 16; k++)
+      buf[k] = i + k;
+    if (write(fd, buf, 16) != 16)
+      return 1;
+    if ((i & 63) == 63) {
+      if (lseek(fd, -16 * 32, SEEK_CUR) < 0 || read(fd, back, 16) != 16)
+        return 1;
+      sum += back[3];
+      lseek(fd, 0, SEEK_END);
+    }
+  }
+
+  close(fd);
+  unlink("003.syscall.tmp");
+
+  /* Checksum of the default SCALE */
+  if (SCALE == 20000 && sum != 0x9fa8u)
+    return 1;
+  return 0;
+}
+
+/* The file end.h is included if compiler flag -DENDCODE is used */
+#ifdef ENDCODE
+#include "end.h"
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file      004.branch.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ * @brief     Branch-heavy kernel: a switch-based bytecode interpreter,
+ *            calls through a table of function pointers, data-dependent
+ *            conditions and recursion.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+/* The file begin.h is included if compiler flag -DBEGINCODE is used */
+#ifdef BEGINCODE
+#include "begin.h"
+#endif
+
+#ifndef SCALE
+#define SCALE 5000
+#endif
+
+#define CODE_SIZE 256
+
+static unsigned int op_add(unsigned int a, unsigned int b) { return a + b; }
+static unsigned int op_xor(unsigned int a, unsigned int b) { return a ^ b; }
+static unsigned int op_rot(unsigned int a, unsigned int b) { return (a << (b & 31)) | (a >> ((32 - (b & 31)) & 31)); }
+static unsigned int op_min(unsigned int a, unsigned int b) { return a < b ? a : b; }
+
+static unsigned int (*ops[4])(unsigned int, unsigned int) = { op_add, op_xor, op_rot, op_min };
+
+static int fib(int n) {
+  return (n < 2) ? n : fib(n - 1) + fib(n - 2);
+}
+
+int main() {
+
+  static unsigned char code[CODE_SIZE];
+  unsigned int seed = 3, acc = 0, reg = 1;
+  int iter, pc, i;
+
+  for (i = 0; i < CODE_SIZE; i++) {
+    seed = seed * 1103515245u + 12345u;
+    code[i] = (seed >> 16) & 7;
+  }
+
+  for (iter = 0; iter < SCALE; iter++) {
+    for (pc = 0; pc < CODE_SIZE; pc++) {
+      switch (code[pc]) {
+      case 0: acc += reg; break;
+      case 1: reg = reg * 3 + 1; break;
+      case 2: if (acc & 1) acc >>= 1; else acc = acc * 5 + 1; break;
+      case 3: acc = ops[reg & 3](acc, reg); break;
+      case 4: if (acc > reg) reg ^= acc; break;
+      case 5: reg = ops[acc & 3](reg, pc); break;
+      case 6: if ((acc ^ reg) & 4) pc++; break;
+      default: acc -= pc; break;
+      }
+    }
+    acc += fib(12 + (iter & 3));
+    reg += iter;
+  }
+
+  /* Checksum of the default SCALE */
+  if (SCALE == 5000 && (acc != 0x48e3abau || reg != 0x4a6f763u))
+    return 1;
+  return 0;
+}
+
+/* The file end.h is included if compiler flag -DENDCODE is used */
+#ifdef ENDCODE
+#include "end.h"
+#endif
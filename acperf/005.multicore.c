@@ -0,0 +1,85 @@
+/**
+ * @file      005.multicore.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ * @brief     Multicore kernel: every core hashes its share of a buffer in
+ *            shared memory and publishes the result; core 0 waits for
+ *            the others and checks the total. Built with -DNCORES=n and
+ *            -DCORE_ID_ADDR=a, where a is the address at which the
+ *            platform gives each core its number. Runs on a single core
+ *            otherwise.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+/* The file begin.h is included if compiler flag -DBEGINCODE is used */
+#ifdef BEGINCODE
+#include "begin.h"
+#endif
+
+#ifndef SCALE
+#define SCALE 256
+#endif
+
+#ifndef NCORES
+#define NCORES 1
+#endif
+
+#define WORDS (1 << 14)
+
+static unsigned int buffer[WORDS];
+static volatile unsigned int partial[NCORES];
+static volatile unsigned int done[NCORES];
+
+static unsigned int core_id(void) {
+#ifdef CORE_ID_ADDR
+  return *(volatile unsigned int *) CORE_ID_ADDR;
+#else
+  return 0;
+#endif
+}
+
+int main() {
+
+  unsigned int id = core_id(), sum = 0, total = 0;
+  int iter, i, lo, hi;
+
+  lo = id * (WORDS / NCORES);
+  hi = lo + WORDS / NCORES;
+  for (i = lo; i < hi; i++)
+    buffer[i] = i * 2654435761u;
+
+  for (iter = 0; iter < SCALE; iter++)
+    for (i = lo; i < hi; i++) {
+      buffer[i] = (buffer[i] ^ (buffer[i] >> 7)) * 0x9e3779b1u + iter;
+      sum += buffer[i] >> 3;
+    }
+
+  partial[id] = sum;
+  done[id] = 1;
+  if (id != 0)
+    return 0;
+
+  for (i = 0; i < NCORES; i++) {
+    while (!done[i])
+      ;
+    total += partial[i];
+  }
+
+  /* Checksum of the default SCALE, whatever the number of cores */
+  if (SCALE == 256 && total != 0x5df3a3eeu)
+    return 1;
+  return 0;
+}
+
+/* The file end.h is included if compiler flag -DENDCODE is used */
+#ifdef ENDCODE
+#include "end.h"
+#endif
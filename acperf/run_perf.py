@@ -0,0 +1,234 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# run_perf.py
+# Runs the performance kernels of this directory on a simulator, records
+# the results in a history file and compares them with a baseline.
+#
+# The ArchC Team
+#
+from __future__ import print_function
+
+import getopt
+import json
+import os
+import re
+import socket
+import subprocess
+import sys
+import time
+
+USAGE = """Use: %s [options] --simulator=SIM ARCH
+
+Runs the kernels NNN.name.ARCH of the current directory on SIM, appends the
+results to the history file and compares them with the baseline.
+
+Options:
+  --simulator=SIM        Simulator running the single core kernels
+  --platform=SIM         Simulator of a multicore platform, for the multicore
+                         kernel (skipped if not given)
+  --runs=N               Runs of each kernel, the fastest is kept (3)
+  --history=FILE         History file, one JSON record per line
+                         (perf-history.json)
+  --label=TEXT           Label of the record, e.g. the revision simulated
+  --baseline=FILE        Compare with the last record of FILE with the same
+                         ARCH instead of the one of the history
+  --threshold=PCT        Slow-down of the speed or start-up time counted as a
+                         regression (5)
+  --rss-threshold=PCT    Growth of the peak memory counted as a regression (10)
+  --no-record            Do not append the results to the history
+"""
+
+instr_re = re.compile(r' *Number of instructions executed: (?P<n>\d+)')
+phase_re = re.compile(r' *Phase (?P<name>[\w.-]+): (?P<s>[\d.]+) s')
+
+
+def run_once(sim, prog):
+    """Runs prog on sim; returns the exit status, the wall and processor
+    times, the peak resident set in kB and the output of the simulator."""
+    start = time.time()
+    p = subprocess.Popen([sim, '--load=' + prog], stdout=subprocess.PIPE,
+                         stderr=subprocess.STDOUT, universal_newlines=True)
+    output = p.stdout.read()
+    pid, status, usage = os.wait4(p.pid, 0)
+    wall = time.time() - start
+    p.stdout.close()
+    if os.WIFEXITED(status):
+        status = os.WEXITSTATUS(status)
+    else:
+        status = 128 + os.WTERMSIG(status)
+    return status, wall, usage.ru_utime + usage.ru_stime, usage.ru_maxrss, output
+
+
+def measure(sim, prog, runs):
+    """Runs prog runs times; returns the results of the fastest run, or of
+    the first that failed."""
+    best = None
+    for i in range(runs):
+        status, wall, cpu, rss, output = run_once(sim, prog)
+        instrs = 0
+        phases = {}
+        for line in output.splitlines():
+            m = instr_re.match(line)
+            if m:
+                instrs += int(m.group('n'))   # one line per core
+            m = phase_re.match(line)
+            if m:
+                phases[m.group('name')] = phases.get(m.group('name'), 0.0) + float(m.group('s'))
+        result = {
+            'status': status,
+            'instructions': instrs,
+            'wall': round(wall, 4),
+            'cpu': round(cpu, 4),
+            'rss_kb': rss,
+            'mips': round(instrs / cpu / 1e6, 3) if cpu > 0 else 0.0,
+            'phases': phases,
+        }
+        if status != 0:
+            return result
+        if best is None or result['wall'] < best['wall']:
+            best = result
+    return best
+
+
+def load_history(path):
+    records = []
+    if os.path.exists(path):
+        f = open(path)
+        for line in f:
+            line = line.strip()
+            if line:
+                records.append(json.loads(line))
+        f.close()
+    return records
+
+
+def compare(record, base, threshold, rss_threshold):
+    """Prints the comparison of record with base; returns the number of
+    regressions."""
+    regressions = 0
+    print('%-16s %10s %10s %8s %10s %10s %8s' %
+          ('kernel', 'MIPS', 'base', 'change', 'RSS kB', 'base', 'change'))
+    for name in sorted(record['kernels']):
+        cur = record['kernels'][name]
+        old = base['kernels'].get(name)
+        if old is None or cur['status'] != 0 or old['status'] != 0:
+            continue
+        flags = []
+        if name.endswith('startup'):
+            # Speed means nothing here: the wall time is the start-up time
+            change = pct(cur['wall'], old['wall'])
+            if change > threshold:
+                flags.append('START-UP')
+            print('%-16s %9.3fs %9.3fs %+7.1f%%' % (name, cur['wall'], old['wall'], change), end='')
+        else:
+            change = pct(cur['mips'], old['mips'])
+            if -change > threshold:
+                flags.append('SPEED')
+            print('%-16s %10.2f %10.2f %+7.1f%%' % (name, cur['mips'], old['mips'], change), end='')
+        rss_change = pct(cur['rss_kb'], old['rss_kb'])
+        if rss_change > rss_threshold:
+            flags.append('MEMORY')
+        print(' %10d %10d %+7.1f%% %s' % (cur['rss_kb'], old['rss_kb'], rss_change, ' '.join(flags)))
+        regressions += len(flags)
+    return regressions
+
+
+def pct(new, old):
+    return (new - old) * 100.0 / old if old else 0.0
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'h', [
+            'help', 'simulator=', 'platform=', 'runs=', 'history=', 'label=',
+            'baseline=', 'threshold=', 'rss-threshold=', 'no-record'])
+    except getopt.GetoptError as e:
+        print(e, file=sys.stderr)
+        print(USAGE % sys.argv[0], file=sys.stderr)
+        return 2
+
+    sim = platform = baseline = None
+    runs = 3
+    history = 'perf-history.json'
+    label = ''
+    threshold = 5.0
+    rss_threshold = 10.0
+    record_it = True
+    for o, v in opts:
+        if o in ('-h', '--help'):
+            print(USAGE % sys.argv[0])
+            return 0
+        elif o == '--simulator':
+            sim = os.path.abspath(v)
+        elif o == '--platform':
+            platform = os.path.abspath(v)
+        elif o == '--runs':
+            runs = int(v)
+        elif o == '--history':
+            history = v
+        elif o == '--label':
+            label = v
+        elif o == '--baseline':
+            baseline = v
+        elif o == '--threshold':
+            threshold = float(v)
+        elif o == '--rss-threshold':
+            rss_threshold = float(v)
+        elif o == '--no-record':
+            record_it = False
+    if sim is None or len(args) != 1:
+        print(USAGE % sys.argv[0], file=sys.stderr)
+        return 2
+    arch = args[0]
+
+    suffix = '.' + arch
+    progs = sorted(f for f in os.listdir('.') if f.endswith(suffix) and re.match(r'\d{3}\.', f))
+    if not progs:
+        print('No kernels built for %s: run "make -f Makefile.archc ARCH=%s build".' % (arch, arch),
+              file=sys.stderr)
+        return 2
+
+    record = {
+        'date': time.strftime('%Y-%m-%d %H:%M:%S'),
+        'label': label,
+        'arch': arch,
+        'simulator': sim,
+        'host': socket.gethostname(),
+        'kernels': {},
+    }
+    failed = 0
+    for prog in progs:
+        name = prog[:-len(suffix)]
+        if 'multicore' in name:
+            if platform is None:
+                continue
+            result = measure(platform, prog, runs)
+        else:
+            result = measure(sim, prog, runs)
+        record['kernels'][name] = result
+        if result['status'] != 0:
+            failed += 1
+            print('%s: FAILED (exit status %d)' % (name, result['status']), file=sys.stderr)
+        else:
+            print('%s: %.2f MIPS, %d instructions, %.3f s, %d kB' %
+                  (name, result['mips'], result['instructions'], result['wall'], result['rss_kb']))
+
+    past = [r for r in load_history(baseline or history) if r.get('arch') == arch]
+    regressions = 0
+    if past:
+        base = past[-1]
+        print('\nCompared with %s %s:' % (base['date'], base.get('label', '')))
+        regressions = compare(record, base, threshold, rss_threshold)
+        print('%d regression(s)' % regressions)
+
+    if record_it:
+        f = open(history, 'a')
+        f.write(json.dumps(record, sort_keys=True) + '\n')
+        f.close()
+
+    return 1 if (failed or regressions) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
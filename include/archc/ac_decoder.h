@@ -65,6 +65,8 @@ typedef struct _control_flow {
   int  delay_slot;            //!< Number of delay slots
   char *delay_slot_cond;      //!< Condition to execute instructions in the delay slots
   char *action;               //!< Any other action to be performed (C/C++ block)
+  char *call_ret;             //!< Return address of a call (is_call)
+  char *return_cond;          //!< Condition for the jump to be a return (is_return)
 } ac_control_flow;
 
 //! Instruction type used to build the decoder
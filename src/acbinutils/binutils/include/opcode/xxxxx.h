@@ -54,4 +54,7 @@ extern const int num_symbols;
 extern const char *pseudo_instrs[];
 extern const int num_pseudo_instrs;
 
+/* Prints an instruction into buf, for the simulator traces (opcodes library) */
+extern int `disassemble_insn_'___arch_name___` (unsigned long insn, int insn_size, unsigned long memaddr, char *buf, int len);'
+
 #endif
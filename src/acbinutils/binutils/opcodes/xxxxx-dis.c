@@ -50,17 +50,58 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
 // Disassembler generation definitions...
 
 /*
-  Linked list with all the operands of the isntruction.
-  oper_id -> position of field in the instruction, later used to know about the size of field
-  type -> type of field e.g. reg, addr, immm, exp
+  The tables below are built from opcodes[], operands[] and udsymbols[] the
+  first time an instruction is disassembled, so that decoding an instruction
+  takes a few hash probes and no allocation.
 */
-typedef struct _ac_symbol {
-  const char *type;
-  int is_list;
-  unsigned int oper_id;
-  struct _ac_symbol *next;
-} ac_symbol;
 
+#define DIS_MAX_FIELDS 16
+
+/*
+  Bits of the instruction holding an operand, in the order they are
+  concatenated.
+*/
+typedef struct {
+  unsigned int num_fields;
+  unsigned int start[DIS_MAX_FIELDS];
+  unsigned int mask[DIS_MAX_FIELDS];
+  unsigned int size[DIS_MAX_FIELDS];
+  unsigned int bit_size;
+} dis_operand;
+
+/*
+  Pre-parsed syntax of an instruction: the text between its operands and the
+  operand ids, e.g. args = "%0:,%1:(%2:)" gives
+  piece = {"\t", ",", "(", ")"} and oper = {0, 1, 2}.
+*/
+typedef struct {
+  unsigned int num_opers;
+  const char **piece;
+  unsigned int *oper;
+} dis_syntax;
+
+/*
+  Opcodes with the same decoding mask and size, hashed by image. A bucket
+  holds the first such opcode of the table with that image.
+*/
+typedef struct {
+  unsigned long dmask;
+  unsigned long size;
+  int first;              /* lowest opcode index of the group */
+  unsigned int hash_mask;
+  int *bucket;            /* opcode index, or -1 */
+} dis_group;
+
+static int dis_ready = 0;
+static dis_operand *dis_operands;
+static dis_syntax *dis_syntaxes;
+static dis_group *dis_groups;
+static int dis_num_groups;
+
+/* Symbols hashed by value, each chain in table order */
+#define DIS_SYMBOL_HASH 1024
+static int dis_symbol_head[DIS_SYMBOL_HASH];
+static int *dis_symbol_next;
 
 struct private
 {
@@ -71,24 +112,13 @@ struct private
   jmp_buf    bailout;
 };
 
-/*----------------------------------------------------------------------------*/
-
-/*
-   bufInitial variable - set only by parse()
-   Don't ever change these variables elsewhere!
-*/
-char bufInitial[100];
-char bufFinal[100];
-
 /*-----------------------------------------------------------------------------------*/
 
 static int disassemble (bfd_vma memaddr, struct disassemble_info *info, unsigned long insn, int insn_size);
 
 int `print_insn_'___arch_name___` (bfd_vma memaddr, struct disassemble_info * info);'
 
-ac_symbol* parse(char *args);
-
-void replace(char *str, const char *old, char *new);
+int `disassemble_insn_'___arch_name___` (unsigned long insn, int insn_size, unsigned long memaddr, char *buf, int len);'
 
 void decode_modifier(mod_parms *mp, unsigned int oper_id);
 
@@ -126,7 +156,7 @@ fetch_data (struct disassemble_info *info, bfd_byte *addr){
  * Every bit set as one, marks the number encoded in the bitvector 
  * For example: 0x80000000 => 31 
  */ 
-unsigned int get_bit_pos(unsigned int bitvector, unsigned int pos) {
+static unsigned int get_bit_pos(unsigned int bitvector, unsigned int pos) {
   unsigned curr_bit = 0; pos++;
   while(1) {
     if (bitvector & (1 << curr_bit))
@@ -136,34 +166,245 @@ unsigned int get_bit_pos(unsigned int bitvector, unsigned int pos) {
   }
 }
 
-unsigned long get_value_from_fields(unsigned int oper_id, 
-                                    unsigned long insn,
-                                    unsigned long *bit_size) {
-
-  unsigned int i=0, j=0, mask=0, size=0, final_value=0;
-  unsigned int num_fields = get_num_fields(operands[oper_id].fields);
-
-  for (; i < num_fields; i++) {
-    /* If we don't encode both start and end bits, we don't know 
-       which field a start bit is refering to */
-    unsigned field_start = get_bit_pos(operands[oper_id].fields_positions, i*2);
-    unsigned field_end = get_bit_pos(operands[oper_id].fields_positions, (i*2)+1);
-    unsigned field_size = field_end-field_start+1;
-
-    /* Create a mask to extract the needed bits from the isns, and then
-       concatenate disjoint fields and make them printable */
-    for (j=0, mask=0; j < field_size; j++)
-      mask |= (1 << (field_start + j));
-    unsigned value = (insn & mask) >> field_start;
-    
-    /* This function considers that disjoint fields need to be
-       concatenated in the order they appear. For different behavior
-       one should implement custom handling via ac_modifiers. */
-    final_value |= (value << size);
-    size += field_size;
+static unsigned int hash_value(unsigned long v) {
+  v ^= v >> 16;
+  return (unsigned int) (v * 0x9E3779B1u);
+}
+
+/*
+   Computes the bit masks of every operand.
+*/
+static void init_operands(void) {
+  unsigned int i, j, k;
+
+  dis_operands = (dis_operand *) calloc(num_oper_id, sizeof(dis_operand));
+  for (i = 0; i < num_oper_id; i++) {
+    dis_operand *d = &dis_operands[i];
+    unsigned int num_fields = get_num_fields(operands[i].fields);
+
+    if (num_fields > DIS_MAX_FIELDS)
+      num_fields = DIS_MAX_FIELDS;
+    d->num_fields = num_fields;
+    for (j = 0; j < num_fields; j++) {
+      /* If we don't encode both start and end bits, we don't know 
+         which field a start bit is refering to */
+      unsigned field_start = get_bit_pos(operands[i].fields_positions, j*2);
+      unsigned field_end = get_bit_pos(operands[i].fields_positions, (j*2)+1);
+      unsigned field_size = field_end-field_start+1;
+
+      d->start[j] = field_start;
+      d->size[j] = field_size;
+      for (k = 0, d->mask[j] = 0; k < field_size; k++)
+        d->mask[j] |= (1 << (field_start + k));
+      d->bit_size += field_size;
+    }
+  }
+}
+
+/*
+   Groups the opcodes by decoding mask and size.
+*/
+static void init_groups(void) {
+  int i, g;
+
+  dis_groups = (dis_group *) calloc(num_opcodes, sizeof(dis_group));
+  dis_num_groups = 0;
+  for (i = 0; i < num_opcodes; i++) {
+    unsigned long size = get_insn_size(opcodes[i].format_id);
+
+    if (opcodes[i].pseudo_idx != 0)
+      continue;
+    for (g = 0; g < dis_num_groups; g++)
+      if ((dis_groups[g].dmask == opcodes[i].dmask) && (dis_groups[g].size == size))
+        break;
+    if (g == dis_num_groups) {
+      dis_groups[g].dmask = opcodes[i].dmask;
+      dis_groups[g].size = size;
+      dis_groups[g].first = i;
+      dis_num_groups++;
+    }
+    dis_groups[g].hash_mask++;   /* counts the members for now */
+  }
+
+  for (g = 0; g < dis_num_groups; g++) {
+    dis_group *grp = &dis_groups[g];
+    unsigned int buckets = 4;
+
+    while (buckets < 2 * grp->hash_mask)
+      buckets <<= 1;
+    grp->hash_mask = buckets - 1;
+    grp->bucket = (int *) malloc(buckets * sizeof(int));
+    memset(grp->bucket, -1, buckets * sizeof(int));
   }
 
-  *bit_size = size;
+  /* Groups are made in the order of their first opcode: inserting in table
+     order leaves the first opcode of each image in the table */
+  for (i = 0; i < num_opcodes; i++) {
+    unsigned long size = get_insn_size(opcodes[i].format_id);
+    unsigned int h;
+
+    if (opcodes[i].pseudo_idx != 0)
+      continue;
+    for (g = 0; (dis_groups[g].dmask != opcodes[i].dmask) || (dis_groups[g].size != size); g++)
+      ;
+    for (h = hash_value(opcodes[i].image) & dis_groups[g].hash_mask;
+         dis_groups[g].bucket[h] >= 0;
+         h = (h + 1) & dis_groups[g].hash_mask)
+      if (opcodes[dis_groups[g].bucket[h]].image == opcodes[i].image)
+        break;
+    if (dis_groups[g].bucket[h] < 0)
+      dis_groups[g].bucket[h] = i;
+  }
+}
+
+static void init_symbols(void) {
+  int i;
+
+  for (i = 0; i < DIS_SYMBOL_HASH; i++)
+    dis_symbol_head[i] = -1;
+  dis_symbol_next = (int *) malloc((num_symbols + 1) * sizeof(int));
+  for (i = num_symbols - 1; i >= 0; i--) {
+    unsigned int h = hash_value(udsymbols[i].value) & (DIS_SYMBOL_HASH - 1);
+    dis_symbol_next[i] = dis_symbol_head[h];
+    dis_symbol_head[h] = i;
+  }
+}
+
+static void dis_init(void) {
+  init_operands();
+  init_groups();
+  init_symbols();
+  dis_syntaxes = (dis_syntax *) calloc(num_opcodes, sizeof(dis_syntax));
+  dis_ready = 1;
+}
+
+/*
+   Index of the first non-pseudo opcode below limit matching insn of
+   insn_size bits, -1 if none.
+*/
+static int find_opcode(unsigned long insn, unsigned long insn_size, int limit) {
+  int g, best = -1;
+
+  if (!dis_ready)
+    dis_init();
+
+  for (g = 0; g < dis_num_groups; g++) {
+    dis_group *grp = &dis_groups[g];
+    unsigned long e;
+    unsigned int h;
+
+    /* Groups are sorted by their first opcode */
+    if ((grp->first >= limit) || ((best >= 0) && (grp->first > best)))
+      break;
+    if (grp->size != insn_size)
+      continue;
+    e = insn & grp->dmask;
+    for (h = hash_value(e) & grp->hash_mask; grp->bucket[h] >= 0; h = (h + 1) & grp->hash_mask)
+      if (opcodes[grp->bucket[h]].image == e) {
+        if ((grp->bucket[h] < limit) && ((best < 0) || (grp->bucket[h] < best)))
+          best = grp->bucket[h];
+        break;
+      }
+  }
+  return best;
+}
+
+/*
+   Symbol of type cspec with the given value: the first one of the table,
+   or the last one if last is set. NULL if none.
+*/
+static const char *find_symbol(const char *cspec, unsigned long value, int last) {
+  const char *found = NULL;
+  int i;
+
+  for (i = dis_symbol_head[hash_value(value) & (DIS_SYMBOL_HASH - 1)]; i >= 0; i = dis_symbol_next[i])
+    if ((udsymbols[i].value == value) && (strcmp(cspec, udsymbols[i].cspec) == 0)) {
+      found = udsymbols[i].symbol;
+      if (!last)
+        break;
+    }
+  return found;
+}
+
+/*
+   Splits the args string of an opcode into its operands and the text
+   between them. The first blank (after a mnemonic suffix) becomes a tab,
+   "\\" is dropped along with the modifier name that follows it.
+*/
+static dis_syntax *get_syntax(int idx) {
+  dis_syntax *s = &dis_syntaxes[idx];
+  const char *args = opcodes[idx].args;
+  unsigned int n = 0, len = strlen(args);
+  int is_mnemonic_suffix = 1;
+  char *text, *out;
+  const char *p;
+
+  if (s->piece)
+    return s;
+
+  for (p = args; *p; p++)
+    if (*p == '%')
+      n++;
+  s->piece = (const char **) malloc((n + 1) * sizeof(char *));
+  s->oper = (unsigned int *) malloc((n + 1) * sizeof(unsigned int));
+  out = text = (char *) malloc(len + n + 2);
+  s->piece[0] = text;
+
+  while (*args != '\0') {
+    //symbol '%' indicate a initial field
+    if (*args == '%') {
+      unsigned int operand_id = 0;
+
+      args++;
+      //symbol ':' indicate a final field
+      while ((*args != ':') && (*args != '+') && (*args != '\0'))
+        operand_id = operand_id * 10 + (*args++ - '0');
+      if (*args != '\0')
+        args++;
+      *out++ = '\0';
+      s->oper[s->num_opers++] = operand_id;
+      s->piece[s->num_opers] = out;
+
+      //verify aditional fiels
+      if (*args == '+') {
+        *out++ = '+';
+        args++;
+      }
+    }
+    else if (*args == '\\') { //ignore char "\\"
+      args++;
+      if (*args != '\0')
+        args++;
+      //ignore char "lo", "hi"...
+      while ((*args>64 && *args<91) || (*args>96 && *args<123))
+        args++;
+    }
+    else if (*args == ' ' && is_mnemonic_suffix) {
+      is_mnemonic_suffix = 0;
+      *out++ = '\t';
+      args++;
+    }
+    else
+      *out++ = *args++;
+  }
+  *out = '\0';
+  return s;
+}
+
+/*
+   Value of operand oper_id in insn. Disjoint fields are concatenated in
+   the order they appear; for different behavior one should implement
+   custom handling via ac_modifiers.
+*/
+static unsigned long get_operand_value(unsigned int oper_id, unsigned long insn) {
+  const dis_operand *d = &dis_operands[oper_id];
+  unsigned int i, size = 0, final_value = 0;
+
+  for (i = 0; i < d->num_fields; i++) {
+    unsigned value = (insn & d->mask[i]) >> d->start[i];
+    final_value |= (value << size);
+    size += d->size[i];
+  }
   return final_value;
 }
 
@@ -175,16 +416,136 @@ long sign_extend_to_long(long v, unsigned int bit_size) {
 
 /*------------------------------------------------------------------------------------*/
 
+typedef struct {
+  char *out;
+  char *end;   /* last char of the buffer, kept for the '\0' */
+} dis_buffer;
+
+static void put_str(dis_buffer *b, const char *s) {
+  while ((*s != '\0') && (b->out < b->end))
+    *b->out++ = *s++;
+  *b->out = '\0';
+}
+
+static void put_hex(dis_buffer *b, unsigned long value) {
+  char text[24];
+
+  sprintf(text, "0x%01lx", value);
+  put_str(b, text);
+}
+
+/*
+   Prints operand oper_id of insn. Registers and other user defined operands
+   are printed by name, if found in the symbol table. Immediates, addresses
+   and expressions go through their decode modifier; the value of an address
+   or expression is kept in addr_value, the one of an immediate in imm_value.
+*/
+static void format_operand(dis_buffer *b, unsigned int oper_id, unsigned long insn, unsigned long memaddr,
+                           unsigned long *addr_value, long *imm_value) {
+  const char *type = operands[oper_id].name;
+  unsigned long value = get_operand_value(oper_id, insn);
+  const char *symbol;
+  mod_parms mp;
+
+  if (operands[oper_id].is_list) {
+    //verify list decode modifier
+    mp.input = value;
+    mp.address = memaddr;
+    mp.addend = operands[oper_id].mod_addend;
+    mp.list_results = NULL;
+    decode_modifier(&mp, oper_id);
+    if (mp.list_results != NULL) {
+      node_list_op_results *p_list;
+
+      for (p_list = mp.list_results; p_list; p_list = p_list->next) {
+        symbol = find_symbol(type, p_list->result, 0);
+        if (symbol)
+          put_str(b, symbol);
+        else
+          put_hex(b, p_list->result);
+        if (p_list->next != NULL)
+          put_str(b, ",");
+      }
+      free_list_results(&(mp.list_results));
+    }
+    else
+      put_hex(b, value);
+  }
+  else if (strcmp(type, "exp") && strcmp(type, "imm") && strcmp(type, "addr")) {
+    /* If the value is not found in the symbol table, it will be an
+       immediate field or another thing: print the value directly */
+    symbol = find_symbol(type, value, 1);
+    if (symbol)
+      put_str(b, symbol);
+    else
+      put_hex(b, value);
+  }
+  else {
+    //operand type is: exp, imm or addr
+    mp.input = value;
+    mp.address = memaddr;
+    mp.addend = operands[oper_id].mod_addend;
+    mp.list_results = NULL;
+
+    // Put the instruction on the addend so the
+    // modifier can play around in several ways.
+    if (!mp.addend)
+      mp.addend = insn;
+
+    decode_modifier(&mp, oper_id);
+    if (mp.output != 0)
+      value = mp.output;
+    put_hex(b, value);
+
+    if (!(strcmp(type, "imm")))
+      *imm_value = sign_extend_to_long(value, dis_operands[oper_id].bit_size);
+
+    // if type is exp or addr, save its value. it can reference a symbol, and
+    // we want to print it as comment, eg. mov    r0, 0x10203    ; 10203 <.helloword>
+    if (!(strcmp(type, "exp") && strcmp(type, "addr")))
+      *addr_value = value;
+  }
+}
+
 /*
-  Function that makes the disassembler of an instruction of the object file, making the decoding using the field dmask of the file xxxxx-opc.c
+   Prints the mnemonic and operands of insn, an instruction of insn_size
+   bits at memaddr, into buf (len chars). An instruction not found in the
+   opcodes table is printed as a number (.data section). Returns the size
+   of the instruction in bits.
+*/
+static int format_insn(unsigned long insn, int insn_size, unsigned long memaddr, char *buf, int len,
+                       unsigned long *addr_value, long *imm_value) {
+  dis_buffer b;
+  dis_syntax *s;
+  unsigned int i;
+  int idx;
+
+  b.out = buf;
+  b.end = buf + len - 1;
+  *b.out = '\0';
+  *addr_value = 0;
+  *imm_value = 0;
+
+  idx = find_opcode(insn, insn_size, num_opcodes);
+  if (idx < 0) {
+    put_hex(&b, insn);
+    return insn_size;
+  }
 
-1- Using the insn apllies the mask (dmaks fiels of opcodes)
-2- Search in instruction table the corresponding instruction of (insn & dmask), and prints the intruction mnemonic.
-3- For each operand, is generated a mask in the position of the field in insn and size (e.g. bit 16 to the 24), after verified if is a register, or immediate, address, etc...
-4- if is a register, is called the method replace to put the name of the register in the final string that it will be printed 
-5- is an immediate one!,  then it verifies the modifiers, and it applies them, after calls the method replace to put the value in the final string(bufFinal). 
-6- prints string(bufFinal) in the screen with the disassembled instruction.  
-7- returns the octets processed, to be able to increment the address (PC) 
+  s = get_syntax(idx);
+  put_str(&b, opcodes[idx].mnemonic);
+  put_str(&b, s->piece[0]);
+  for (i = 0; i < s->num_opers; i++) {
+    format_operand(&b, s->oper[i], insn, memaddr, addr_value, imm_value);
+    put_str(&b, s->piece[i + 1]);
+  }
+  return get_insn_size(opcodes[idx].format_id);
+}
+
+/*
+  Function that makes the disassembler of an instruction of the object file,
+  prints it with the functions of info and returns the octets processed, to
+  be able to increment the address (PC).
 
 Params
   memaddr - address of the current instruction (PC value)
@@ -192,175 +553,19 @@ Params
   insn - the raw instruction
 */
 static int disassemble (bfd_vma memaddr, struct disassemble_info *info, unsigned long insn, int insn_size){
-  acasm_opcode *op = (acasm_opcode *) opcodes;
-  acasm_symbol *symbols = (acasm_symbol *) udsymbols;
-  unsigned int FORMAT_SIZE=0;
-  int nInstr=0;
-  unsigned addr_value = 0;
-  long imm_value = 0;
-
-  //Find the mnemonic of instruction in opcodes table
-  while (nInstr < num_opcodes){
-    unsigned long e = insn & op->dmask;
-
-    if ((e == op->image) && (op->pseudo_idx == 0) && ((unsigned)insn_size == get_insn_size(op->format_id))) {
-
-      FORMAT_SIZE = get_insn_size(op->format_id);
-
-      //Print instruction mnemonic
-      (*info->fprintf_func) (info->stream,"%s",op->mnemonic);
-
-      //Now look for operands
-      char *args = malloc(sizeof(char)*50);
-      strcpy(args, op->args);
-      ac_symbol* acs = parse(args);
-
-      char *ptInitial = bufInitial;
-      char *ptFinal = bufFinal;      
-      strcpy(ptFinal,ptInitial);
-
-      while (acs){
-        unsigned long size = 0;
-        unsigned int numf = get_num_fields(operands[acs->oper_id].fields);
-        unsigned int count, fid;
-	symbols = (acasm_symbol *) udsymbols;
-	int cont = 0;
-	int in = 0;
-	char symbolaux[100];
-        fid = 0;
-
-        /* Get the value that should be printed from the instruction */
-        unsigned int bit_size = 0;
-        unsigned long value = get_value_from_fields(acs->oper_id, insn, &bit_size);	
-
-	if (acs->is_list){
-	  node_list_op_results *p_list;
-	  
-	  //verify list decode modifier
-	  mod_parms mp;
-	  mp.input = value;
-	  mp.address = memaddr;
-	  mp.addend = operands[acs->oper_id].mod_addend;
-	  mp.list_results = NULL;
-	  decode_modifier(&mp, acs->oper_id);
-	  if (mp.list_results != NULL) {
-	    p_list = mp.list_results;	    
-	    int leng = 0;
-	    while (p_list) {	 	      
-	      cont = 0;
-	      in = 0;
-	      symbols = (acasm_symbol *) udsymbols;
-	      while (cont < num_symbols){
-		if ((strcmp(acs->type, symbols->cspec) == 0) && (p_list->result == symbols->value)){//operand find
-		  in = 1;
-		  strcpy(&(symbolaux[leng]), symbols->symbol);		  
-		  leng += strlen(&(symbolaux[leng]));
-		  if (p_list->next != NULL)
-		  {
-		    symbolaux[leng] = ',';
-		    symbolaux[leng+1] = '\0';
-		    leng++;
-		  }
-		  break;
-		}
-		symbols++;
-		cont++;
-	      }
-	      if (!in) {
-		sprintf(symbolaux, "0x%x", p_list->result);
-	      }	      	      
-	      p_list = p_list->next;
-	    }// fim while (p_list)
-	    replace(bufFinal, acs->type, symbolaux);
-	    free_list_results(&(mp.list_results));
-	  }// if (mp.list_results != NULL)
-	  else {
-	    sprintf(symbolaux, "0x%lx", value);
-	    replace(bufFinal, acs->type, symbolaux);
-	  }// fim if
-        // if (acs->is_list)
-	} else {	  
-
-	  if (strcmp(acs->type, "exp") && strcmp(acs->type, "imm") && strcmp(acs->type, "addr"))
-	  {
-	    /* Search the register table, looking value (taken from the dmask) is a register and finds the
-	    name of the register and prints it as operating of instruction, if not found, will be an
-	    immediate field or another thing it prints the value directly,*/
-    
-	    while (cont < num_symbols){
-	      if ((strcmp(acs->type, symbols->cspec) == 0) && (value == symbols->value)){//operand find
-		in = 1;
-		strcpy(symbolaux, symbols->symbol);
-	      }
-	      symbols++;
-	      cont++;
-	    }
-    
-	    if (in){
-	      replace(bufFinal, acs->type, symbolaux);
-	    } else{
-	      // Could not find operand symbol
-	      sprintf(symbolaux, "0x%lx", value);
-	      replace(bufFinal, acs->type, symbolaux);
-	    }
-	  } else {
-            //operand type is: exp, imm or addr
-  
-	    //verify decode modifier
-	    mod_parms mp;
-	    mp.input = value;
-	    mp.address = memaddr;
-	    mp.addend = operands[acs->oper_id].mod_addend;
-	    mp.list_results = NULL;
-
-            // Put the instruction on the addend so the
-            // modifier can play around in several ways.
-            if (!mp.addend)
-              mp.addend = insn;
-
-	    decode_modifier(&mp, acs->oper_id);
-	    if (mp.output != 0)
-	      value = mp.output;	    
-  
-	    char *ptr3;
-	    ptr3 = bufFinal;
-	    char new[50];
-	    //Convert long to char
-	    sprintf( new, "0x%01lx", value );
-	    replace(ptr3,acs->type,new);
-
-            if (!(strcmp(acs->type, "imm")))
-              imm_value = sign_extend_to_long(value, bit_size);  
-	    
-	    // if type is exp or addr, save its value. it can reference a symbol, and
-	    // we want to print it as comment, eg. mov    r0, 0x10203    ; 10203 <.helloword>
-	    if (! (strcmp(acs->type, "exp") && strcmp(acs->type, "addr")) )
-	      addr_value = value;
-	  }// end if (strcmp(acs->type, "exp") && strcmp(acs->type, "imm") && strcmp(acs->type, "addr"))
-	}//end if (acs->is_list)
-        acs = acs->next;
-      }
-      break;
-    }
-    op++;
-    nInstr++;
-  }
- 
-  //.data Section
-  if (FORMAT_SIZE == 0) {
-    FORMAT_SIZE = insn_size;
-    //Convert long to char
-    sprintf( bufFinal, "0x%01lx", insn );
-  }
+  char text[256];
+  unsigned long addr_value;
+  long imm_value;
+  int size = format_insn(insn, insn_size, memaddr, text, sizeof(text), &addr_value, &imm_value);
 
-  (*info->fprintf_func) (info->stream,"%s",bufFinal);
+  (*info->fprintf_func) (info->stream,"%s",text);
   if (addr_value) {
-    (*info->fprintf_func) (info->stream,"\t; ", addr_value);
+    (*info->fprintf_func) (info->stream,"\t; ");
     info->print_address_func (addr_value, info);
   } else if (imm_value != 0) {
     (*info->fprintf_func) (info->stream,"\t; %ld", imm_value);
   }
-  return  FORMAT_SIZE / 8;
+  return size / 8;
 }
 /*------------------------------------------------------------------------------------*/
 
@@ -381,8 +586,6 @@ int `print_insn_'___arch_name___` (bfd_vma memaddr, struct disassemble_info * in
   if (setjmp (priv.bailout) != 0) /* Error return.  */
     return -1;
 
-  acasm_opcode *op = (acasm_opcode *) opcodes;
-
   /* Verify if architecture has variable format size (CISC) ou no (RISC) */
   if (VARIABLE_FORMAT_SIZE == 0) {
     /*RISC - read fix length bits of the memory */
@@ -397,31 +600,33 @@ int `print_insn_'___arch_name___` (bfd_vma memaddr, struct disassemble_info * in
        2- if has format size > 8, read 16 bits and find instruction in opcodes table
        3- if has format size > 16, read 24 bits and find instruction in opcodes table
        4- if has format size > 24, read 32 bits and find instruction in opcodes table
-       Decode last insn find.
+       Decode last insn find. The search stops at the first opcode without
+       decoding mask.
     */
     unsigned int localsize = 8;
     unsigned int i;
+    int limit;
+
+    if (!dis_ready)
+      dis_init();
+    for (limit = 0; (limit < num_opcodes) && (opcodes[limit].dmask != 0); limit++)
+      ;
+
+    insnfound = 0;
+    sizeinsn = 8;
     while (localsize <= MAX_FORMAT_SIZE) {
       FETCH_DATA (info, buffer + (localsize / 8));
       for (i=3; i>=(localsize/8); i--)
         buffer[i] = 0;
       insn = getbits(localsize, (char *)buffer, ___endian_val___);
 
-      //Find the mnemonic of instruction in opcodes table
-      int j = 0;     
-      while ((j < num_opcodes) && (op->dmask != 0)) {
-        unsigned long e = insn & op->dmask;
-
-        if ((e == op->image) && (op->pseudo_idx == 0) && (localsize == get_insn_size(op->format_id))){
-          insnfound = insn;
-          sizeinsn = localsize;
-          break;
-        }
-        op++;
-        j++;
+      if (localsize == 8)
+        insnfound = insn;
+      if (find_opcode(insn, localsize, limit) >= 0) {
+        insnfound = insn;
+        sizeinsn = localsize;
       }
       localsize = localsize + 8;
-      op = op - j;
     }
   }
 
@@ -432,145 +637,22 @@ int `print_insn_'___arch_name___` (bfd_vma memaddr, struct disassemble_info * in
 /*------------------------------------------------------------------------------------*/
 
 /*
-Example:
-input args = %0:,%1:,%2:
-output bufInitial = reg,reg,imm
-*/
-ac_symbol* parse(char *args){
-  char *ptr_bufInitial = bufInitial;
-  ac_symbol *lista = NULL;
-  ac_symbol *temp;
-  ac_symbol *t;
-  t = NULL;
-  temp = NULL;
-  int is_mnemonic_suffix = 1;
-  int i = 0;
-
-  //loop in the chars of args
-  while (*args != '\0'){
-    char buf[50];
-    char *ptr_buf = buf;
-
-    //symbol '%' indicate a initial field
-    if (*args == '%'){
-      args++;
-      //symbol ':' indicate a final field
-      while ((*args != ':') && (*args != '+')){
-        *ptr_buf = *args;
-        *ptr_bufInitial = '\0';
-        ptr_buf++;
-        args++;
-      }
-      *ptr_buf = '\0';
-      args++; 
-
-      //operand_id is the index of fiels in the struct operands
-      unsigned int operand_id = atoi(buf);
-      unsigned int count;
-
-      //replace index of field the bufInitial to type of field e.g. reg, addr, immm, exp
-      strcat(ptr_bufInitial, operands[operand_id].name);
-      for (count=0; count < strlen(operands[operand_id].name); count++)
-        ptr_bufInitial++;
-
-      //verify aditional fiels
-      if (*args == '+') {
-        strcat(ptr_bufInitial, "+");
-        ptr_bufInitial++;
-        args++;
-      }
-
-      if (i > 0){ //more elements of list
-        temp = (ac_symbol *) malloc(sizeof(ac_symbol));
-        temp->oper_id = operand_id;
-	temp->is_list = operands[operand_id].is_list;
-        temp->type = operands[operand_id].name;
-        temp->next = NULL;
-        lista->next = temp;
-        lista = lista->next;
-      }
-      else{ //first element of list
-        lista = (ac_symbol *) malloc(sizeof(ac_symbol));
-        t = lista;
-        lista->oper_id = operand_id;
-	lista->is_list = operands[operand_id].is_list;
-        lista->type = operands[operand_id].name;
-        lista->next = NULL;
-      }
-      i++;
-    }
-    else{  //if (*args=='%')          
-      if (*args == '\\'){ //ignore char "\\"
-        args++;
-        args++;
-        //ignore char "lo", "hi"...
-        while ((*args>64 && *args<91) || (*args>96 && *args<123))
-          args++;
-      }
-      else{
-	if (*args == ' ' && is_mnemonic_suffix)
-	{
-	  is_mnemonic_suffix = 0;
-	  *ptr_bufInitial = '\t';
-	  args++;
-	  ptr_bufInitial++;
-	}
-	else
-	{
-          *ptr_bufInitial = *args;
-          args++;
-          ptr_bufInitial++;
-	}
-      }
-    }
-  }//end of while (*args!='\0')
-
-  *ptr_bufInitial = '\0';
-  lista = t;
-  return lista;
-}
-/*----------------------------------------------------------------------------*/
-
-/*
-   Function that from parameter 'ptr_ret' search for the first occurrence of 'old' and substitutes for 'new' 
-   e.g.: ptr_ret = addi reg,reg,exp
-       old = reg
-       new = $30
-   result:
-       ptr_ret = addi $30,reg,exp
+   Entry point for the simulators: prints insn, an instruction of insn_size
+   bits at memaddr, into buf (len chars), with the value of its address or
+   immediate operand as a comment. Returns the size of the instruction in
+   bytes.
 */
-void replace(char *ptr_ret, const char *old, char *new){
-  char a[50];
-  char *str = a;
-
-  strcpy(str, ptr_ret);
-
-  while (*str != '\0'){
-    if (strncmp(old, str, strlen(old)) == 0){
-      while (*old == *str){
-        old++;
-        if (*str != '\0')
-        str++;
-      }
-      while (*new != '\0'){
-        *ptr_ret = *new;
-        ptr_ret++;
-        new++;
-      }
-      while (*str != '\0'){
-        *ptr_ret = *str;
-        str++;
-        ptr_ret++;
-      }
-    }
-    else{
-      *ptr_ret = *str;
-      str++;
-      ptr_ret++;
-    }
-  }
-
-  *ptr_ret = '\0';
+int `disassemble_insn_'___arch_name___` (unsigned long insn, int insn_size, unsigned long memaddr, char *buf, int len){'
+  unsigned long addr_value;
+  long imm_value;
+  int size = format_insn(insn, insn_size, memaddr, buf, len, &addr_value, &imm_value);
+  int used = strlen(buf);
+
+  if (addr_value)
+    snprintf(buf + used, len - used, "\t; 0x%lx", addr_value);
+  else if (imm_value != 0)
+    snprintf(buf + used, len - used, "\t; %ld", imm_value);
+  return size / 8;
 }
 /*------------------------------------------------------------------------------------*/
 
@@ -33,6 +33,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "acsim.h"
 #include "accsim.h"
@@ -186,6 +187,9 @@ int accs_main()
   extern int stage_num;
   extern int HaveMultiCycleIns;
   extern int HaveFormattedRegs;
+  struct timeval gen_start, gen_end;
+
+  gettimeofday(&gen_start, NULL);
 
   //Assert there is no pipeline stages
   if (stage_num > 0) {
@@ -321,7 +325,13 @@ int accs_main()
 
   }
 
+  ac_output_close_all();
+  gettimeofday(&gen_end, NULL);
+
   AC_MSG("%s model files generated for compiled simulation with program %s.\n", project_name, ACCompsimProg);
+  AC_MSG("Generation took %.2f s: %d files written, %d unchanged (their objects are reused by make).\n",
+         (gen_end.tv_sec - gen_start.tv_sec) + (gen_end.tv_usec - gen_start.tv_usec) / 1e6,
+         ac_outputs_written, ac_outputs_unchanged);
   return 0;
 }
 
@@ -755,7 +765,7 @@ void CreateBhvMacroEmpty()
   // Create empty file
   /* opens behavior macros file */
   sprintf(filename, "%s_bhv_macros.H", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -774,19 +784,19 @@ void CreateBhvMacroEmpty()
  
   fprintf(output, "#include \"%s.H\"\n", project_name );
  
-  fclose(output);
+  ac_output_close(output);
 
   //--
 
   sprintf(filename, "%s_isa_init.cpp", project_name);
-   if ( !(output = fopen( filename, "w"))){
+   if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
 
   fprintf(output, "//Empty file\n\n");
 
-  fclose(output); 
+  ac_output_close(output); 
 
 }
 
@@ -809,7 +819,7 @@ void accs_CreateCompsimHeader()
 
 
   sprintf( filename, "%s.H", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -916,7 +926,12 @@ void accs_CreateCompsimHeader()
 		   "	    ac_mt_endian(0),\n"
 		   "	    ac_annul_sig(0)\n"
 		   "	    { ac_instr_counter = 0; \n"
-		   "	      ac_start_addr = 0; } \n\n");
+		   "	      ac_interp_counter = 0; \n"
+		   "	      ac_next_region = 0; \n"
+		   "	      ac_ras_top = 0; \n"
+		   "	      for (int i = 0; i < %d; i++) ac_ras_pc[i] = ~0u; \n"
+		   "	      ac_ic_hits = ac_ic_misses = ac_ras_hits = ac_ras_misses = 0; \n"
+		   "	      ac_start_addr = 0; } \n\n", RAS_SIZE);
 
  
   fprintf( output, "	// Timing structures.\n");
@@ -968,6 +983,23 @@ void accs_CreateCompsimHeader()
       }
 
   fprintf( output, "\n");
+  fprintf( output, "	// Interpreter for the addresses with no compiled code\n");
+  fprintf( output, "	unsigned long long ac_interp_counter;\n");
+  fprintf( output, "	unsigned long long InterpGetBits(unsigned addr, int last, int quantity, int sign);\n");
+  fprintf( output, "	unsigned InterpInstr(unsigned interp_pc);\n");
+  fprintf( output, "	void Interpret();\n");
+  fprintf( output, "\n");
+  fprintf( output, "	// Regions entered without the Execute switch: target caches of the\n");
+  fprintf( output, "	// indirect branches and return address stack\n");
+  fprintf( output, "	typedef void (%s::*ac_region_t)();\n", project_name);
+  fprintf( output, "	struct ac_ic_entry { unsigned pc; ac_region_t region; };\n");
+  fprintf( output, "	ac_region_t ac_next_region;\n");
+  fprintf( output, "	ac_region_t RegionFor(unsigned pc);\n");
+  fprintf( output, "	unsigned ac_ras_pc[%d];\n", RAS_SIZE);
+  fprintf( output, "	ac_region_t ac_ras_region[%d];\n", RAS_SIZE);
+  fprintf( output, "	unsigned ac_ras_top;\n");
+  fprintf( output, "	unsigned long long ac_ic_hits, ac_ic_misses, ac_ras_hits, ac_ras_misses;\n");
+  fprintf( output, "\n");
 
   //Generic instruction behavior
   COMMENT(INDENT[3],"Generic instruction behavior","\n");
@@ -1034,7 +1066,7 @@ void accs_CreateCompsimHeader()
   fprintf( output, "\n");
  
   fprintf( output, "#endif  //_AC_COMPSIM_H\n");
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -1049,10 +1081,13 @@ void accs_CreateCompsimImpl()
   extern unsigned char *instr_mem;
   extern char *ACCompsimProg;
   extern int ACABIFlag;
+  extern int ACCompsimFlag;
 
   char filename[256];
   FILE *output;
   int i,j,k, next_instr, rblock;
+  int nregions, nblocks, nhot, nhotfiles, nfile;
+  int *region_class, *file_regions;
   int invalid_instr_count = 0;
   int *stat_instr_used = (int *) calloc(instr_num+1, sizeof(int));
   //char *instr_mem_p;
@@ -1103,7 +1138,7 @@ void accs_CreateCompsimImpl()
         //verify if it is a control instr and mark the target and the next as leaders
         {
           ac_control_flow *cflow = GetInstrByID(decoder->instructions, fields[0])->cflow;
-          if (cflow) {
+          if (cflow && cflow->target) {
             eval_input = accs_SubstFields(cflow->target, j);
             if ((eval_parse() != 0) || (eval_result > prog_size_bytes)) {
               //jump register instructions will always report a parse error
@@ -1177,15 +1212,36 @@ void accs_CreateCompsimImpl()
 
 
 
+  //Classify the regions from the profile given with "-pf" (all cheap without one)
+  nregions = ((prog_size_bytes-1) >> REGION_SIZE) + 1;
+  region_class = accs_ProfileRegions(nregions);
+  nblocks = (nregions - 1) / REGION_BLOCK_SIZE + 1;
+  for (i=0, nhot=0; i < nregions; i++)
+    if (region_class[i] == REGION_HOT) nhot++;
+  nhotfiles = (nhot + REGION_BLOCK_SIZE - 1) / REGION_BLOCK_SIZE;
+  file_regions = (int *) malloc(sizeof(int) * REGION_BLOCK_SIZE);
+
   //Write in separate files, to minimize compilation overhead
   //  select number of Regions per file with command-line option "-bs"
-  for (rblock=0; rblock <= (((prog_size_bytes-1) >> REGION_SIZE) / REGION_BLOCK_SIZE); rblock++) {
-
-    // Open file
-    if (rblock == 0) sprintf( filename, "%s.cpp", project_name);
-    else             sprintf( filename, "%s-block%d.cpp", project_name, rblock);
+  //  hot regions go to their own files, compiled with more optimization
+  for (rblock=0; rblock < nblocks + nhotfiles; rblock++) {
+
+    // Open file and select its regions
+    nfile = 0;
+    if (rblock < nblocks) {
+      if (rblock == 0) sprintf( filename, "%s.cpp", project_name);
+      else             sprintf( filename, "%s-block%d.cpp", project_name, rblock);
+      for (i=rblock*REGION_BLOCK_SIZE; (i < (rblock+1)*REGION_BLOCK_SIZE) && (i < nregions); i++)
+        if (region_class[i] != REGION_HOT) file_regions[nfile++] = i;
+    }
+    else {
+      sprintf( filename, "%s-hot%d.cpp", project_name, rblock - nblocks);
+      for (i=0, k=0; i < nregions; i++)
+        if ((region_class[i] == REGION_HOT) && (k++ / REGION_BLOCK_SIZE == rblock - nblocks))
+          file_regions[nfile++] = i;
+    }
 
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1237,8 +1293,9 @@ void accs_CreateCompsimImpl()
              "//!Trace file\n"
              "#ifdef AC_DEBUG\n"
              "#include <iostream>\n"
-             "extern std::ofstream trace_file;\n"
-             "#define PRINT_TRACE trace_file << std::hex << ((int)ac_pc) << \"\\n\"\n"
+             "#include \"ac_trace.H\"\n"
+             "extern ac_trace_writer trace_file;\n"
+             "#define PRINT_TRACE trace_file.instr((int)ac_pc, 0)\n"
              "#else \n"
              "#define PRINT_TRACE /* nothing */\n"
              "#endif\n"
@@ -1248,6 +1305,12 @@ void accs_CreateCompsimImpl()
     // Write other variables
     if (rblock == 0) {
       if (COUNT_SYSCALLS)  COUNT_SYSCALLS_Init(output);
+      fprintf(output,
+              "#ifdef AC_REGION_PROFILE\n"
+              "//Instructions executed in each region, saved for \"-pf\"\n"
+              "static unsigned long long ac_region_instrs[%d];\n"
+              "#endif\n"
+              "\n", nregions);
 //      if (ACABIFlag)       fprintf(output, "%s_syscall model_syscall;\n\n", project_name);
     }
 
@@ -1261,11 +1324,18 @@ void accs_CreateCompsimImpl()
 
     // @@@@@@@@@@@@@@@@@ kernel of compiled simulation @@@@@@@@@@@@@@@@@@@@@@@
 
-    for (i=rblock*REGION_BLOCK_SIZE;
-         ((i < (rblock+1)*REGION_BLOCK_SIZE) && (i <= ((prog_size_bytes-1) >> REGION_SIZE)));
-         i++) {
-      int end_region = (prog_size_bytes < ((i+1) << REGION_SIZE)) ? prog_size_bytes : ((i+1) << REGION_SIZE);
-    
+    for (k=0; k < nfile; k++) {
+      int end_region;
+
+      i = file_regions[k];
+      end_region = (prog_size_bytes < ((i+1) << REGION_SIZE)) ? prog_size_bytes : ((i+1) << REGION_SIZE);
+
+      // Never executed in the profile: no compiled code
+      if (region_class[i] == REGION_INTERP) {
+        fprintf(output, "void %s::Region%d() {\n  Interpret();\n}\n\n\n", project_name, i);
+        continue;
+      }
+
       // Region function start
       fprintf(output, "void %s::Region%d() {\n", project_name, i);
       fprintf(output,
@@ -1307,18 +1377,21 @@ void accs_CreateCompsimImpl()
       if ((PROCESSOR_OPTIMIZATIONS)&&(ACMulticoreFlag==1)) 
       	fprintf( output, "      old_pc = ac_pc;\n");
       if (i == EXIT_ADDRESS>>REGION_SIZE) fprintf( output, "      if (ac_pc == %d) return;\n", EXIT_ADDRESS);
+      fprintf( output, "      if ((ac_pc >= %d) && (ac_pc < %d)) {\n", (i << REGION_SIZE), ((i+1) << REGION_SIZE));
+      if (ACCompsimFlag == 1)
+        fprintf( output, "        Interpret();\n");
+      else
+        fprintf( output,
+                 "        AC_ERROR(\"ac_pc=0x\" << hex << int(ac_pc) << \" points to an non-decoded memory location.\" << endl);\n"
+                 "        stop(EXIT_FAILURE);\n");
       fprintf( output,
-               "      if ((ac_pc >= %d) && (ac_pc < %d)) {\n"
-               "        AC_ERROR(\"ac_pc=0x\" << hex << int(ac_pc) << \" points to an non-decoded memory location.\" << endl);\n"
-               "        stop(EXIT_FAILURE);\n"
                "      }\n"
                "      return;\n"
                "    }\n"
                "  }\n"
                "}\n"
                "\n"
-               "\n"
-               , (i << REGION_SIZE), ((i+1) << REGION_SIZE));
+               "\n");
     }
 
 
@@ -1327,9 +1400,29 @@ void accs_CreateCompsimImpl()
 
       fprintf(output, "void %s::Execute(int argc, char *argv[]) {\n\n", project_name);
       if (ACABIFlag) {fprintf(output, "  set_prog_args(argc, argv);\n\n");}
+      fprintf(output,
+              "#ifdef AC_REGION_PROFILE\n"
+              "  unsigned long long region_start;\n"
+              "  unsigned region;\n"
+              "#endif\n"
+              "\n");
       fprintf(output,
              // "  extern int ac_stop_flag;\n"
               "  while (!ac_stop_flag) {\n"
+              "#ifdef AC_REGION_PROFILE\n"
+              "    region_start = ac_instr_counter + ac_interp_counter;\n"
+              "    region = ac_pc >> %d;\n"
+              "#endif\n"
+              , REGION_SIZE);
+      if (BRANCH_CACHE)
+        fprintf(output,
+                "    if (ac_next_region) {\n"
+                "      ac_region_t next = ac_next_region;\n"
+                "      ac_next_region = 0;\n"
+                "      (this->*next)();\n"
+                "    }\n"
+                "    else\n");
+      fprintf(output,
               "    switch(ac_pc >> %d) {\n"
               "\n"
               , REGION_SIZE);
@@ -1342,14 +1435,22 @@ void accs_CreateCompsimImpl()
                 //cygwin don't recognize %1$s to specify an argument 'cause uses newlib
                 , j, j);
       }
+      fprintf(output, "    default:\n");
+      if (ACCompsimFlag == 1)
+        fprintf(output, "      Interpret();\n");
+      else
+        fprintf(output,
+                "      AC_ERROR(\"ac_pc=0x\" << hex << int(ac_pc) << \" is beyond program memory.\" << std::endl);\n"
+                "      stop(EXIT_FAILURE);\n");
       fprintf(output,
-              "    default:\n"
-              "      AC_ERROR(\"ac_pc=0x\" << hex << int(ac_pc) << \" is beyond program memory.\" << std::endl);\n"
-              "      stop(EXIT_FAILURE);\n"
               "      break;\n"
               "    }\n"
+              "#ifdef AC_REGION_PROFILE\n"
+              "    if (region < %d)\n"
+              "      ac_region_instrs[region] += ac_instr_counter + ac_interp_counter - region_start;\n"
+              "#endif\n"
               "  }\n"
-              );
+              , nregions);
 
       if (COUNT_SYSCALLS) {
         COUNT_SYSCALLS_EmitPrintStat(output);
@@ -1361,6 +1462,19 @@ void accs_CreateCompsimImpl()
               "\n"
               );
 
+	if (ACCompsimFlag == 1)
+	  accs_EmitInterpreter(output);
+
+	fprintf(output, "%s::ac_region_t %s::RegionFor(unsigned pc) {\n", project_name, project_name);
+	fprintf(output, "  static const ac_region_t regions[%d] = {\n", nregions);
+	for (j=0; j < nregions; j++)
+	  fprintf(output, "    &%s::Region%d,\n", project_name, j);
+	fprintf(output,
+		"  };\n"
+		"  return ((pc >> %d) < %d) ? regions[pc >> %d] : 0;\n"
+		"}\n"
+		"\n", REGION_SIZE, nregions, REGION_SIZE);
+
 	fprintf(output, "#include <ac_sighandlers.H>\n\n");	
       	fprintf(output, "void %s::init(int ac, char **av){\n", project_name);
       	fprintf(output, "	this->ac = ac;\n");
@@ -1417,12 +1531,34 @@ void accs_CreateCompsimImpl()
 	fprintf(output, "		ac_run_real / 100, ac_run_real %% 100\n");
 	fprintf(output, "		);\n\n");
 	fprintf(output, "	fprintf(stderr, \"    Number of instructions executed: %%llu\\n\", ac_instr_counter);\n");
+	fprintf(output, "	if (ac_interp_counter)\n");
+	fprintf(output, "		fprintf(stderr, \"    Instructions interpreted (no compiled code): %%llu\\n\", ac_interp_counter);\n");
+	fprintf(output, "	if (ac_ic_hits + ac_ic_misses)\n");
+	fprintf(output, "		fprintf(stderr, \"    Indirect branch target cache: %%llu hits, %%llu misses (%%.1f%%%%)\\n\",\n");
+	fprintf(output, "			ac_ic_hits, ac_ic_misses, 100.0 * ac_ic_hits / (ac_ic_hits + ac_ic_misses));\n");
+	fprintf(output, "	if (ac_ras_hits + ac_ras_misses)\n");
+	fprintf(output, "		fprintf(stderr, \"    Return address stack: %%llu hits, %%llu misses (%%.1f%%%%)\\n\",\n");
+	fprintf(output, "			ac_ras_hits, ac_ras_misses, 100.0 * ac_ras_hits / (ac_ras_hits + ac_ras_misses));\n");
 	fprintf(output, "	if (ac_run_times.tms_utime > 5) {\n");
 	fprintf(output, "		double ac_mips = (ac_instr_counter * 100) / ac_run_times.tms_utime;\n");
 	fprintf(output, "		fprintf(stderr, \"    Simulation speed: %%.2f K instr/s\\n\", ac_mips/1000);\n");
 	fprintf(output, "	} else {\n");
 	fprintf(output, "		fprintf(stderr, \"    Simulation speed: (too fast to be precise)\\n\");\n");
 	fprintf(output, "	}\n");
+	fprintf(output,
+		"#ifdef AC_REGION_PROFILE\n"
+		"	char profile_name[1024];\n"
+		"	snprintf(profile_name, sizeof(profile_name), \"%%s.regions\", appfilename);\n"
+		"	FILE *profile = fopen(profile_name, \"w\");\n"
+		"	if (profile) {\n"
+		"		fprintf(profile, \"# ArchC region profile: REGION_SIZE %d\\n\");\n"
+		"		for (unsigned i = 0; i < %d; i++)\n"
+		"			if (ac_region_instrs[i])\n"
+		"				fprintf(profile, \"0x%%x %%llu\\n\", i << %d, ac_region_instrs[i]);\n"
+		"		fclose(profile);\n"
+		"		fprintf(stderr, \"    Region profile written to %%s\\n\", profile_name);\n"
+		"	}\n"
+		"#endif\n", REGION_SIZE, nregions, REGION_SIZE);
 	fprintf(output, "} \n\n");
 
 	// inserindo codigos do ac_syscall.cpp 
@@ -2231,15 +2367,34 @@ fprintf( output,
 
 
     // Close file
-    fclose( output);
+    ac_output_close(output);
 
   }
 
+  //Remove the blocks left by a previous, larger program or profile: the
+  //  Makefile compiles every $(MODULE)-block*.cpp and $(MODULE)-hot*.cpp
+  for (rblock=nblocks;; rblock++) {
+    sprintf( filename, "%s-block%d.cpp", project_name, rblock);
+    if (unlink(filename) != 0)
+      break;
+    sprintf( filename, "%s-block%d.o", project_name, rblock);
+    unlink(filename);
+  }
+  for (rblock=nhotfiles;; rblock++) {
+    sprintf( filename, "%s-hot%d.cpp", project_name, rblock);
+    if (unlink(filename) != 0)
+      break;
+    sprintf( filename, "%s-hot%d.o", project_name, rblock);
+    unlink(filename);
+  }
+
 
   // Free memory
   for (j=0; j<prog_size_bytes; j++) {free(decode_table[j]);}
   free(decode_table);
   free(stat_instr_used);
+  free(region_class);
+  free(file_regions);
 }
 
 
@@ -2249,7 +2404,7 @@ void accs_CreateCompsimHeaderRegions()
   int i;
   FILE *output;
 
-  if ( !(output = fopen("ac_prog_regions.H", "w"))){
+  if ( !(output = ac_output_open("ac_prog_regions.H"))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2260,7 +2415,7 @@ void accs_CreateCompsimHeaderRegions()
     fprintf(output, "void Region%d();\n", i);
   }
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -2272,7 +2427,7 @@ void fast_CreateStorageHeader()
   extern char *project_name;
   FILE *output;
 
-  output = fopen("ac_storage.H", "w");
+  output = ac_output_open("ac_storage.H");
 
   print_comment( output, "ArchC Storage header file.");
 
@@ -2457,6 +2612,7 @@ void fast_CreateStorageHeader()
           "  void write(access_t datum) {return write(0,datum);}\n"
           "\n"
           "  unsigned int GetStart() {return start;}\n"
+          "  unsigned int GetSize() {return size;}\n"
           "\n"
           "  elem_t *raw_data(unsigned address) const\n"
           "  {\n"
@@ -2696,7 +2852,7 @@ void fast_CreateStorageHeader()
           , (ac_tgt_endian)? "(2 - (address & unalign))*8" : "(address & unalign)*8"
           );
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -2705,7 +2861,7 @@ void fast_CreateStorageHeader()
 void fast_CreateStorageImpl()
 {
   FILE *output;
-  output = fopen("ac_storage.cpp", "w");
+  output = ac_output_open("ac_storage.cpp");
   extern char *project_name;
 
   print_comment( output, "ArchC Storage implementation file.");
@@ -2826,7 +2982,7 @@ void fast_CreateStorageImpl()
 "\n"
           );
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 /*!Create ArchC Resources Header File */
@@ -2840,7 +2996,7 @@ void fast_CreateFileResourcesHeader()
   extern char *project_name;
 
   FILE *output;
-  output = fopen("ac_resources.H", "w");
+  output = ac_output_open("ac_resources.H");
 
   print_comment( output, "ArchC Resources header file.");
 
@@ -2967,7 +3123,7 @@ void fast_CreateFileResourcesHeader()
 
   fprintf( output, "#endif  //_AC_RESOURCES_H\n");
 
-  fclose( output);
+  ac_output_close(output);
 }
 
 
@@ -2983,7 +3139,7 @@ void fast_CreateFileResourcesImpl()
   int i;
 
   FILE *output;
-  output = fopen("ac_resources.cpp", "w");
+  output = ac_output_open("ac_resources.cpp");
 
   print_comment( output, "ArchC Resources implementation file.");
 
@@ -3114,7 +3270,7 @@ void fast_CreateFileResourcesImpl()
     
   //fprintf( output, "};\n\n");
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -3357,7 +3513,7 @@ void accs_CreateProgramMemoryHeader()
   char filename[] = "ac_progmem.H";
   extern char *ACCompsimProg;
 
-  if ( !(output = fopen( filename, "wb"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3377,7 +3533,7 @@ void accs_CreateProgramMemoryHeader()
   fprintf( output, "//Input program: %s\n", ACCompsimProg);
   fprintf( output, "INCBIN(mem_dump, \"ac_progmem.bin\");\n");
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -3389,14 +3545,14 @@ void accs_CreateProgramMemoryImpl()
   FILE *output;
   char filename[] = "ac_progmem.bin";
 
-  if ( !(output = fopen( filename, "wb"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
 
   fwrite(data_mem, ac_heap_ptr, 1, output);
 
-  fclose( output);
+  ac_output_close(output);
 }
 
 
@@ -3414,7 +3570,7 @@ void accs_CreateMain()
   FILE  *output;
 
   sprintf( description, "This is the main file for the %s ArchC model", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3505,7 +3661,7 @@ void accs_CreateMain()
           "};\n", project_name
           );
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -3527,7 +3683,7 @@ void accs_CreateISAHeader()
   char filename[50];
   
   snprintf(filename, 50, "%s_isa.H", project_name);
-  output = fopen(filename, "w");
+  output = ac_output_open(filename);
 
   print_comment( output, "ISA header file.");
 
@@ -3634,7 +3790,7 @@ void accs_CreateISAHeader()
 #endif  
   fprintf( output, "#endif //_ISA_H\n");
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -3649,7 +3805,7 @@ void accs_CreateISAImpl()
   char filename[50];
 
   snprintf(filename, 50, "%s_isa.cpp", project_name);
-  output = fopen(filename, "w");
+  output = ac_output_open(filename);
 
   print_comment( output, "ISA implementation file.");
   fprintf( output, "#include \"%s_isa.H\"\n\n", project_name);
@@ -3668,7 +3824,7 @@ void accs_CreateISAImpl()
     fprintf( output, "};\n");
   */
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 char *strtoupper(char *str){
@@ -3694,7 +3850,7 @@ void accs_CreateArchSyscallHeader()
   char filename[50];
   
   snprintf(filename, 50, "%s_syscall_macros.H", project_name);
-  output = fopen(filename, "w");
+  output = ac_output_open(filename);
   fprintf( output, "//In Compiled Simulation, no exist model_syscall class. That methods in model class.\n\n");
   fprintf( output, "#ifndef %s_SYSCALL_H\n", project_name);
   fprintf( output, "#define %s_SYSCALL_H\n", project_name);
@@ -3703,12 +3859,12 @@ void accs_CreateArchSyscallHeader()
   fprintf( output, "#define %s_syscall %s\n\n", project_name, project_name);
   fprintf( output, "#endif \n");
 
-  fclose( output);
+  ac_output_close(output);
 
   snprintf(filename, 50, "%s_syscall.H.tmpl", project_name);
-  output = fopen(filename, "w");
+  output = ac_output_open(filename);
   fprintf( output, "//In Compiled Simulation, this file is Empty\n\n");
-  fclose( output);
+  ac_output_close(output);
 
  
 }
@@ -3719,7 +3875,7 @@ void accs_CreateArchSyscallHeader()
 void accs_CreateISAInitImpl()
 {
   FILE *output;
-  output = fopen("ac_isa_init.cpp", "w");
+  output = ac_output_open("ac_isa_init.cpp");
 
   print_comment( output, "ArchC ISA Init implementation file.");
 
@@ -3727,7 +3883,7 @@ void accs_CreateISAInitImpl()
           "// This file is empty for compiled simulation\n"
           );
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -3737,14 +3893,14 @@ void accs_CreateTemplateImpl()
 {
   FILE *output;
 
-  if ( !(output = fopen("ac_template.cpp", "w"))){
+  if ( !(output = ac_output_open("ac_template.cpp"))){
     perror("ArchC could not open output file");
     exit(1);
   }
 
   print_comment( output, "ArchC Template implementation file.");
 
-  fclose( output); 
+  ac_output_close(output); 
 }
 
 
@@ -3852,9 +4008,270 @@ void accs_EmitInstrExtraBottom(FILE* output, int j, ac_dec_instr *pinstr, int in
 }
 
 
+/*!Emit the code executing one instruction decoded at run time: the fields are
+   local variables of the same name, used by the behaviors and by the control
+   flow expressions of the model. Mirrors accs_EmitInstr. */
+void accs_EmitInterpInstr(FILE* output, ac_dec_instr *pinstr)
+{
+  extern ac_dec_field *common_instr_field_list;
+  ac_dec_format *pformat = FindFormat(decoder->formats, pinstr->format);
+  ac_dec_field *pfield, *pcommon;
+  ac_control_flow *cflow = pinstr->cflow;
+  int size = pinstr->size;
+
+  for (pfield = pformat->fields; pfield != NULL; pfield = pfield->next)
+    fprintf( output, "    %s %s = InterpGetBits(interp_pc, %d, %d, %d);\n",
+             (pfield->sign) ? "int" : "unsigned", pfield->name,
+             pfield->first_bit, pfield->size, pfield->sign);
+
+  fprintf( output, "    PRINT_TRACE;\n");
+  fprintf( output, "    ac_interp_counter++;\n");
+
+  //Level 2 does not call the behaviors of control instructions: the
+  //  simulator computes the target, as in PROCESSOR_OPTIMIZATIONS_EmitInstr_2
+  if ((PROCESSOR_OPTIMIZATIONS == 2) && cflow && cflow->target) {
+    fprintf( output, "    unsigned target_pc;\n");
+    fprintf( output, "    if (%s) {\n", cflow->cond ? cflow->cond : "1");
+    fprintf( output, "      target_pc = %s;\n", cflow->target);
+    if ((cflow->action) && (cflow->action[0]))
+      fprintf( output, "      %s\n", cflow->action);
+    fprintf( output, "    }\n");
+    fprintf( output, "    else\n");
+    fprintf( output, "      target_pc = interp_pc + %d;\n", size + (cflow->delay_slot * size));
+    accs_EmitInstrExtraBottom(output, 0, pinstr, 4);
+    if (cflow->delay_slot) {
+      fprintf( output, "    if (%s) {\n", cflow->delay_slot_cond);
+      fprintf( output, "      ac_pc = interp_pc + %d;\n", size);
+      fprintf( output, "      if (!InterpInstr(interp_pc + %d)) return 0;\n", size);
+      fprintf( output, "    }\n");
+    }
+    fprintf( output, "    ac_pc = target_pc;\n");
+  }
+  else {
+    fprintf( output, "    ac_behavior_instruction(%d", size * 8);
+    for (pcommon = common_instr_field_list; pcommon != NULL; pcommon = pcommon->next) {
+      for (pfield = pformat->fields; (pfield != NULL) && strcmp(pfield->name, pcommon->name); pfield = pfield->next);
+      fprintf( output, ", %s", (pfield) ? pfield->name : "0");
+    }
+    fprintf( output, ");\n");
+
+    if (ACAnnulSigFlag)
+      fprintf( output, "    if (!ac_annul_sig) {\n");
+    fprintf( output, "    ac_behavior_%s(%d", pinstr->format, size * 8);
+    for (pfield = pformat->fields; pfield != NULL; pfield = pfield->next)
+      fprintf( output, ", %s", pfield->name);
+    fprintf( output, ");\n");
+    fprintf( output, "    ac_behavior_%s(%d", pinstr->name, size * 8);
+    for (pfield = pformat->fields; pfield != NULL; pfield = pfield->next)
+      fprintf( output, ", %s", pfield->name);
+    fprintf( output, ");\n");
+    if (ACAnnulSigFlag) {
+      fprintf( output, "    } else\n");
+      fprintf( output, "    ac_annul_sig = 0;\n");
+    }
+
+    //Without PC updates in the behaviors, the simulator advances the PC
+    if (PROCESSOR_OPTIMIZATIONS == 2)
+      fprintf( output, "    ac_pc = interp_pc + %d;\n", size);
+    accs_EmitInstrExtraBottom(output, 0, pinstr, 4);
+  }
+
+  if ((PROCESSOR_OPTIMIZATIONS) && (ACMulticoreFlag == 1)) {
+    //Instructions counted here, not from old_pc by the regions
+    fprintf( output, "    ac_instr_counter++;\n");
+    fprintf( output, "    old_pc = ac_pc;\n");
+  }
+  fprintf( output, "    return %d;\n", size);
+}
+
+
+/*!Emit the interpreter used for the addresses that have no compiled code:
+   code outside the regions (e.g. loaded at run time) or not found when the
+   program was decoded (e.g. targets of indirect jumps in opt level 3). It
+   executes one instruction and returns to Execute(), which goes back to the
+   compiled regions as soon as ac_pc reaches an address they know. */
+void accs_EmitInterpreter(FILE* output)
+{
+  extern int wordsize;
+  extern int ac_tgt_endian;
+  ac_sto_list *load_device = accs_FindLoadDevice();
+  ac_dec_instr *pinstr;
+  ac_dec_format *pformat;
+  ac_dec_list *pdeclist;
+  ac_dec_field *pfield;
+  int max_bytes = 0;
+
+  for (pformat = decoder->formats; pformat != NULL; pformat = pformat->next)
+    if (pformat->size / 8 > max_bytes)
+      max_bytes = pformat->size / 8;
+  max_bytes = (max_bytes + wordsize / 8 - 1) / (wordsize / 8) * (wordsize / 8);
+
+  //Same extraction as GetBits() in the pre-processor
+  fprintf(output, "unsigned long long %s::InterpGetBits(unsigned addr, int last, int quantity, int sign) {\n", project_name);
+  fprintf(output,
+          "  int first = last - (quantity-1);\n"
+          "  unsigned long long value = 0;\n"
+          "\n");
+  if (ac_tgt_endian == 1)
+    fprintf(output,
+            "  for (int i = first / %d; i <= last / %d; i++) {\n"
+            "    value <<= %d;\n"
+            "    value |= *(ac_Uword*) %s.raw_data(addr + i * %d);\n"
+            "  }\n"
+            "  value >>= %d - (last %% %d + 1);\n",
+            wordsize, wordsize, wordsize, load_device->name, wordsize / 8, wordsize, wordsize);
+  else
+    fprintf(output,
+            "  for (int i = last / %d; i >= first / %d; i--) {\n"
+            "    value <<= %d;\n"
+            "    value |= *(ac_Uword*) %s.raw_data(addr + i * %d);\n"
+            "  }\n"
+            "  value >>= first %% %d;\n",
+            wordsize, wordsize, wordsize, load_device->name, wordsize / 8, wordsize);
+  fprintf(output,
+          "  value &= ~((~0ULL) << quantity);\n"
+          "  if (sign && (value >> (quantity-1)))\n"
+          "    value |= (~0ULL) << quantity;\n"
+          "  return value;\n"
+          "}\n"
+          "\n");
+
+  //Decoding follows the order of the instruction declarations
+  fprintf(output, "unsigned %s::InterpInstr(unsigned interp_pc) {\n", project_name);
+  for (pinstr = decoder->instructions; pinstr != NULL; pinstr = pinstr->next) {
+    pformat = FindFormat(decoder->formats, pinstr->format);
+    fprintf(output, "  //%s\n", pinstr->name);
+    fprintf(output, "  if (1");
+    for (pdeclist = pinstr->dec_list; pdeclist != NULL; pdeclist = pdeclist->next) {
+      for (pfield = pformat->fields; (pfield != NULL) && strcmp(pfield->name, pdeclist->name); pfield = pfield->next);
+      if (pfield)
+        fprintf(output, " &&\n      InterpGetBits(interp_pc, %d, %d, 0) == %uU",
+                pfield->first_bit, pfield->size, (unsigned) pdeclist->value & (~0U >> (32 - pfield->size)));
+    }
+    fprintf(output, ") {\n");
+    accs_EmitInterpInstr(output, pinstr);
+    fprintf(output, "  }\n");
+  }
+  fprintf(output,
+          "  return 0;\n"
+          "}\n"
+          "\n");
+
+  fprintf(output, "void %s::Interpret() {\n", project_name);
+  fprintf(output,
+          "  unsigned pc = ac_pc;\n"
+          "\n"
+          "  if ((pc < %s.GetStart()) || (pc - %s.GetStart() + %d > %s.GetSize())) {\n"
+          "    AC_ERROR(\"ac_pc=0x\" << hex << int(ac_pc) << \" is beyond program memory.\" << std::endl);\n"
+          "    stop(EXIT_FAILURE);\n"
+          "  }\n"
+          "  else if (!InterpInstr(pc)) {\n"
+          "    AC_ERROR(\"ac_pc=0x\" << hex << int(ac_pc) << \" points to an instruction that could not be decoded.\" << std::endl);\n"
+          "    stop(EXIT_FAILURE);\n"
+          "  }\n"
+          "}\n"
+          "\n"
+          "\n",
+          load_device->name, load_device->name, max_bytes, load_device->name);
+}
+
+
+/*!Classify the regions from the profile given with "-pf": each line has the
+   address of an instruction (or of the start of a region) and the number of
+   instructions executed from it, as written by a simulator built with
+   REGION_PROFILE=1; '#' starts a comment. The hottest regions, which run
+   PGO_HOT_COVERAGE of the instructions, are REGION_HOT, the others that ran
+   are REGION_CHEAP and those that never ran are REGION_INTERP. Region 0
+   keeps the system calls and is always compiled. Without a profile every
+   region is REGION_CHEAP. */
+int *accs_ProfileRegions(int nregions)
+{
+  extern char *ACRegionProfile;
+  extern int ACCompsimFlag;
+  int *region_class = (int *) calloc(nregions, sizeof(int));
+  unsigned long long *count, *sorted, total, covered, lost;
+  unsigned *instrs;
+  int i, j, nclass[3] = {0, 0, 0};
+  unsigned class_instrs[3] = {0, 0, 0};
+  unsigned addr;
+  unsigned long long n;
+  char line[256];
+  FILE *profile;
+
+  if (!ACRegionProfile)
+    return region_class;
+
+  if (!(profile = fopen(ACRegionProfile, "r"))) {
+    AC_ERROR("Could not open region profile file: %s\n", ACRegionProfile);
+    exit(EXIT_FAILURE);
+  }
+  count = (unsigned long long *) calloc(nregions, sizeof(unsigned long long));
+  total = 0;
+  while (fgets(line, sizeof(line), profile)) {
+    if ((line[0] == '#') || (sscanf(line, "%x %llu", &addr, &n) != 2))
+      continue;
+    if ((addr >> REGION_SIZE) < nregions) {
+      count[addr >> REGION_SIZE] += n;
+      total += n;
+    }
+  }
+  fclose(profile);
+
+  //Smallest count still hot: walk the counts in decreasing order
+  sorted = (unsigned long long *) malloc(sizeof(unsigned long long) * nregions);
+  memcpy(sorted, count, sizeof(unsigned long long) * nregions);
+  for (i = 1; i < nregions; i++)
+    for (j = i; (j > 0) && (sorted[j-1] < sorted[j]); j--) {
+      n = sorted[j]; sorted[j] = sorted[j-1]; sorted[j-1] = n;
+    }
+  for (i = 0, covered = 0; (i < nregions) && sorted[i] && (covered < PGO_HOT_COVERAGE * total); i++)
+    covered += sorted[i];
+  n = (i > 0) ? sorted[i-1] : 1;
+
+  //Instructions compiled in each region
+  instrs = (unsigned *) calloc(nregions, sizeof(unsigned));
+  for (j = 0; j < prog_size_bytes; j++)
+    if ((decode_table[j]) && (decode_table[j]->dec_vector))
+      instrs[j >> REGION_SIZE]++;
+
+  lost = 0;
+  for (i = 0; i < nregions; i++) {
+    if (count[i] && (count[i] >= n))
+      region_class[i] = REGION_HOT;
+    else if (count[i] || (i == 0) || (ACCompsimFlag != 1))
+      region_class[i] = REGION_CHEAP;
+    else
+      region_class[i] = REGION_INTERP;
+    if (region_class[i] != REGION_HOT)
+      lost += count[i];
+    nclass[region_class[i]]++;
+    class_instrs[region_class[i]] += instrs[i];
+  }
+
+  AC_MSG("Region profile %s: %llu instructions.\n", ACRegionProfile, total);
+  AC_MSG("   %d hot regions (%u instructions) compiled with HOT_CFLAGS.\n",
+         nclass[REGION_HOT], class_instrs[REGION_HOT]);
+  AC_MSG("   %d cold regions (%u instructions) compiled with COLD_CFLAGS.\n",
+         nclass[REGION_CHEAP], class_instrs[REGION_CHEAP]);
+  AC_MSG("   %d regions never executed (%u instructions) left to the interpreter.\n",
+         nclass[REGION_INTERP], class_instrs[REGION_INTERP]);
+  AC_MSG("   Compile time saved: %.1f%% of the instructions not optimized, %.1f%% not compiled.\n",
+         100.0 * (class_instrs[REGION_CHEAP] + class_instrs[REGION_INTERP]) / (prog_size_instr ? prog_size_instr : 1),
+         100.0 * class_instrs[REGION_INTERP] / (prog_size_instr ? prog_size_instr : 1));
+  AC_MSG("   Runtime lost: %.1f%% of the profiled instructions run outside hot regions.\n",
+         total ? (100.0 * lost / total) : 0.0);
+
+  free(count);
+  free(sorted);
+  free(instrs);
+  return region_class;
+}
+
+
 void accs_EmitMakefileExtra(FILE* output)
 {
   extern int ACP4Flag, ACOmitFPFlag, ACInlineFlag, ACCompsimFlag;
+  extern char *ACRegionProfile;
   fprintf( output, "OPT := $(OPT) ");
   if (ACP4Flag) fprintf( output, "-march=pentium4 ");
   if (ACOmitFPFlag) fprintf( output, "-fomit-frame-pointer ");
@@ -3862,13 +4279,25 @@ void accs_EmitMakefileExtra(FILE* output)
   fprintf( output, "\n");
 
   fprintf( output, "INLINE := %d\n", (ACInlineFlag?1:0));
+  fprintf( output, "REGION_PROFILE := 0\n");
   fprintf( output, "ISA_AND_SYSCALL_TOGETHER := %d\n", (ACInlineFlag || PROCESSOR_OPTIMIZATIONS == 2)? 1 : 0);
   if (PROCESSOR_OPTIMIZATIONS==2)
   	fprintf( output, "CFLAGS := $(CFLAGS) $(if $(filter 1,$(INLINE)),-O3 -finline-functions -fgcse) $(if $(filter 1,$(ISA_AND_SYSCALL_TOGETHER)), -DAC_INLINE) ");
   else	
   	fprintf( output, "CFLAGS := $(CFLAGS) $(if $(filter 1,$(INLINE)),-O -finline-functions -fgcse) $(if $(filter 1,$(ISA_AND_SYSCALL_TOGETHER)), -DAC_INLINE) ");
   if (ACCompsimFlag) fprintf( output, "-DAC_COMPSIM");
+  fprintf( output, "$(if $(filter 1,$(REGION_PROFILE)), -DAC_REGION_PROFILE)");
   fprintf( output, "\n\n");
+
+  //Regions split by "-pf": the hot ones inline the behaviors, the cold ones
+  //  are compiled fast. The main file keeps CFLAGS, Execute() is always hot.
+  fprintf( output, "HOT_CFLAGS := -O3 -finline-functions -DAC_INLINE\n");
+  fprintf( output, "$(MODULE)-hot%%.o: CFLAGS += $(HOT_CFLAGS)\n");
+  if (ACRegionProfile) {
+    fprintf( output, "COLD_CFLAGS := -O0\n");
+    fprintf( output, "$(MODULE)-block%%.o: CFLAGS += $(COLD_CFLAGS)\n");
+  }
+  fprintf( output, "\n");
 }
 
 
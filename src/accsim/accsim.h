@@ -129,6 +129,9 @@ void accs_EmitInstr(FILE* output, int j);
 void accs_EmitInstrBehavior(FILE* output, int j, ac_dec_instr *pinstr, int indent);
 void accs_EmitInstrExtraTop(FILE* output, int j, ac_dec_instr *pinstr, int indent);
 void accs_EmitInstrExtraBottom(FILE* output, int j, ac_dec_instr *pinstr, int indent);
+void accs_EmitInterpInstr(FILE* output, ac_dec_instr *pinstr);
+void accs_EmitInterpreter(FILE* output);
+int *accs_ProfileRegions(int nregions);
 void accs_EmitMakefileExtra(FILE* output);
 void accs_EmitParmsExtra(FILE* output);
 
@@ -40,6 +40,28 @@ int REGION_BLOCK_SIZE=300;
 #define EXIT_ADDRESS 0x64
 #endif
 
+/* Execution profile given with "-pf <file>": the hottest regions, which run
+   PGO_HOT_COVERAGE of the profiled instructions, are compiled aggressively,
+   the others cheaply and those never executed are left to the interpreter */
+char *ACRegionProfile=0;
+
+#ifndef PGO_HOT_COVERAGE
+#define PGO_HOT_COVERAGE 0.90
+#endif
+
+#define REGION_CHEAP  0
+#define REGION_HOT    1
+#define REGION_INTERP 2
+
+/* Level 2 computes branch targets in the simulator: the indirect ones keep
+   a target cache per site and returns (is_return) check a stack filled by
+   calls (is_call), to enter the target region without the Execute switch */
+#define BRANCH_CACHE (PROCESSOR_OPTIMIZATIONS == 2)
+
+#ifndef RAS_SIZE
+#define RAS_SIZE 16
+#endif
+
 ////////////////////////////////
 // COUNT_SYSCALLS
 ////////////////////////////////
@@ -118,6 +140,74 @@ void PROCESSOR_OPTIMIZATIONS_PutBreakOrNot(FILE *output, ac_dec_instr *pinstr, i
 }
 
 
+////////////////////////////////
+// BRANCH_CACHE
+////////////////////////////////
+
+//Push the return address of a taken call on the return address stack
+void BRANCH_CACHE_EmitPush(FILE *output, ac_control_flow *cflow, int j)
+{
+  if (!BRANCH_CACHE || !cflow->call_ret)
+    return;
+
+  eval_input = accs_SubstFields(cflow->call_ret, j);
+  fprintf( output, "        ac_ras_pc[ac_ras_top & %d] = %s;\n", RAS_SIZE-1, eval_input);
+  if ((eval_parse() == 0) && (eval_result < prog_size_bytes))
+    fprintf( output, "        ac_ras_region[ac_ras_top & %d] = &%s::Region%d;\n",
+             RAS_SIZE-1, project_name, eval_result >> REGION_SIZE);
+  else
+    fprintf( output, "        ac_ras_region[ac_ras_top & %d] = RegionFor(%s);\n", RAS_SIZE-1, eval_input);
+  fprintf( output, "        ac_ras_top++;\n");
+}
+
+
+//After ac_pc is set by a branch: enter the target region directly if the
+//  target is not known at generation time
+void BRANCH_CACHE_EmitSite(FILE *output, ac_control_flow *cflow, int j)
+{
+  if (!BRANCH_CACHE)
+    return;
+
+  eval_input = accs_SubstFields(cflow->target, j);
+  if ((eval_parse() == 0) && (eval_result <= prog_size_bytes))
+    return;
+
+  fprintf( output, "      {\n");
+  fprintf( output, "        static ac_ic_entry ac_ic = {~0u, 0};\n");
+  fprintf( output, "        ac_region_t next = 0;\n");
+  if (cflow->return_cond) {
+    fprintf( output, "        if (%s) {\n", accs_SubstFields(cflow->return_cond, j));
+    fprintf( output, "          if (ac_ras_pc[--ac_ras_top & %d] == ac_pc) {\n", RAS_SIZE-1);
+    fprintf( output, "            ac_ras_hits++;\n");
+    fprintf( output, "            next = ac_ras_region[ac_ras_top & %d];\n", RAS_SIZE-1);
+    fprintf( output, "          }\n");
+    fprintf( output, "          else\n");
+    fprintf( output, "            ac_ras_misses++;\n");
+    fprintf( output, "        }\n");
+  }
+  if (cflow->return_cond)
+    fprintf( output, "        if (next)\n"
+                     "          ; //return address stack hit\n"
+                     "        else ");
+  else
+    fprintf( output, "        ");
+  fprintf( output, "if (ac_ic.pc == ac_pc) {\n");
+  fprintf( output, "          ac_ic_hits++;\n");
+  fprintf( output, "          next = ac_ic.region;\n");
+  fprintf( output, "        }\n");
+  fprintf( output, "        else {\n");
+  fprintf( output, "          ac_ic_misses++;\n");
+  fprintf( output, "          ac_ic.pc = ac_pc;\n");
+  fprintf( output, "          next = ac_ic.region = RegionFor(ac_pc);\n");
+  fprintf( output, "        }\n");
+  fprintf( output, "        if ((ac_pc >> %d) != %d) {\n", REGION_SIZE, j >> REGION_SIZE);
+  fprintf( output, "          ac_next_region = next;\n");
+  fprintf( output, "          return;\n");
+  fprintf( output, "        }\n");
+  fprintf( output, "      }\n");
+}
+
+
 //Prototypes
 void PROCESSOR_OPTIMIZATIONS_EmitInstr(FILE *output, int j);
 void PROCESSOR_OPTIMIZATIONS_EmitInstr_1(FILE *output, int j);
@@ -176,7 +266,9 @@ void PROCESSOR_OPTIMIZATIONS_EmitInstr_2(FILE *output, int j)
   ac_control_flow *cflow = pinstr->cflow;
   int jump_instr_size = pinstr->size;
 
-  if (!cflow) {
+  //Instructions marked only with is_call or is_return have no target: their
+  //  behavior sets ac_pc, as for any other instruction
+  if (!cflow || !cflow->target) {
     fprintf( output, "    case 0x%x:\n", j);
     accs_EmitInstrExtraTop(output, j, pinstr, 6);
     accs_EmitInstrBehavior(output, j, pinstr, 6);
@@ -187,13 +279,14 @@ void PROCESSOR_OPTIMIZATIONS_EmitInstr_2(FILE *output, int j)
   else {
     fprintf( output, "    case 0x%x:\n", j);
     fprintf( output, "      //instr: %s, delay=%d (%s)\n", pinstr->name,
-             cflow->delay_slot, cflow->delay_slot_cond);
+             cflow->delay_slot, cflow->delay_slot_cond ? cflow->delay_slot_cond : "");
 
     accs_EmitInstrExtraTop(output, j, pinstr, 6);
-    fprintf( output, "      if (%s) {\n", accs_SubstFields(cflow->cond, j));
+    fprintf( output, "      if (%s) {\n", cflow->cond ? accs_SubstFields(cflow->cond, j) : "1");
     fprintf( output, "        tmp_pc = %s;\n", accs_SubstFields(cflow->target, j));
     if ((cflow->action) && (cflow->action[0]))
       fprintf( output, "        %s\n", accs_SubstFields(cflow->action, j));
+    BRANCH_CACHE_EmitPush(output, cflow, j);
     fprintf( output, "      }\n");
     fprintf( output, "      else {\n");
     fprintf( output, "        tmp_pc = %#x;\n", j + pinstr->size + (cflow->delay_slot * pinstr->size));
@@ -233,6 +326,7 @@ void PROCESSOR_OPTIMIZATIONS_EmitInstr_2(FILE *output, int j)
     fprintf( output, "      ac_pc = tmp_pc;\n");
     if (ACMulticoreFlag == 1)
 	    fprintf( output, "      old_pc = ac_pc;\n");
+    BRANCH_CACHE_EmitSite(output, cflow, j);
     fprintf( output, "      break;\n");
 
     fprintf( output, "\n");
@@ -242,7 +336,7 @@ void PROCESSOR_OPTIMIZATIONS_EmitInstr_2(FILE *output, int j)
 
 void PROCESSOR_OPTIMIZATIONS_EmitInstr_3(FILE *output, int j)
 {
-  static unsigned NEXT_START_REGION=0;
+  static int LAST_REGION=-1;
   ac_dec_instr *pinstr = GetInstrByID(decoder->instructions, decode_table[j]->dec_vector[0]);
   char *args = accs_Fields2Str(decode_table[j]);
 
@@ -251,15 +345,16 @@ void PROCESSOR_OPTIMIZATIONS_EmitInstr_3(FILE *output, int j)
     fprintf( output, "    // IS LEADER from %#x:\n", decode_table[j]->is_leader);
     fprintf( output, "    case 0x%x:\n", j);
   }
-  //put case in start Region (which is the first instruction >= the start of a region)
-  else if (j >= NEXT_START_REGION) {
+  //put case in start Region (which is the first instruction emitted in a region,
+  //  regions may be emitted out of order)
+  else if ((j >> REGION_SIZE) != LAST_REGION) {
     fprintf( output, "    // IS LEADER from START REGION\n");
     fprintf( output, "    case 0x%x:\n", j);
-    NEXT_START_REGION += (1 << REGION_SIZE);
   }
   else {
     fprintf( output, "                               // 0x%x\n", j);
   }
+  LAST_REGION = j >> REGION_SIZE;
 
   accs_EmitInstrExtraTop(output, j, pinstr, 6);
   accs_EmitInstrBehavior(output, j, pinstr, 6);
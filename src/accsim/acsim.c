@@ -47,7 +47,7 @@
 //#define DEBUG_STORAGE
 
 //Defining Traces and Dasm strings
-#define PRINT_TRACE "%strace_file << hex << decode_pc << dec <<\"\\n\";\n"
+#define PRINT_TRACE "%strace_file.instr(decode_pc, 0);\n"
 #define PRINT_DASM "%sdasmfile << hex << decode_pc << dec << \": \" << *instr << *format <<\"\t\t(\" << instr->get_name() << \",\" << format->get_name() << \")\" <<endl;\n"
 
 //#define ARCHC_CONFIG_PATH "/l/archc/archc-2.0/etc/archc.conf"
@@ -125,6 +125,7 @@ struct option_map option_map[] = {
   {"--optimization"  , "-opt"        ,"Use best compiled simulator optimization or set level manually.", "r"},
 /*  {"--inline"        , "-i"          ,"Inline ISA and Syscalls (slow compilation, fast execution)", "r"},*/
   {"--block-size"    , "-bs"         ,"Set the maximum number of regions in a file.", "r"},
+  {"--profile"       , "-pf"         ,"Compile hot regions aggressively and cold ones cheaply, from a region profile file.", "r"},
   {"--multicore"     , "-mc"	     ,"Beta version for static Compiled Simulation multicore.", "r"},
   {"--annul-instr"   , "-ai"         ,"Necessary in models wich the instructions may be executed or not", "r"},
 /*   {"--pentium4"      , "-p4"         ,"Use option for gcc: -march=pentium4.", "r"}, */
@@ -329,6 +330,19 @@ int main( argc, argv )
               }
               ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
               break;
+            case OPProfile:
+              if (argc < 2) {
+                AC_ERROR("Give a region profile file after %s option.\n", argv[0]);
+                exit(EXIT_FAILURE);
+              }
+              else {
+                extern char *ACRegionProfile;
+                ACRegionProfile = argv[1];
+                ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
+                ++argv, --argc, j++;  /* skip over a parameter */
+              }
+              ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
+              break;
             case OPCompsim:
               //This hidden option in the form "-l 2 <filename>" uses the original storage and resources classes (slower)
               if ((argc > 1) && (strcmp(argv[1], "2")==0)) {
@@ -690,7 +704,7 @@ void CreateResourceHeader() {
   FILE *output;
   char filename[] = "ac_resources.H";
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -1054,7 +1068,7 @@ void CreateResourceHeader() {
   fprintf( output, "%s\n", Globals);
 
   fprintf( output, "#endif  //_AC_RESOURCES_H\n");
-  fclose( output); 
+  ac_output_close(output); 
 
 }
 
@@ -1065,7 +1079,7 @@ void CreateTypeHeader() {
   FILE *output;
   char filename[] = "ac_types.H";
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -1152,7 +1166,7 @@ void CreateTypeHeader() {
 
   fprintf( output, "\n\n");
   fprintf( output, "#endif  //_AC_TYPES_H\n");
-  fclose( output); 
+  ac_output_close(output); 
 
 }
 
@@ -1181,7 +1195,7 @@ void CreateTypeHeader() {
     FILE *output;
 
     sprintf(filename, "%s_parms.H", project_name);
-    if ( !(output = fopen(filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1369,7 +1383,7 @@ void CreateTypeHeader() {
     fprintf( output, "\n\n");
     fprintf( output, "#endif  //_%s_PARMS_H\n", upper_project_name);
 
-    fclose(output);
+    ac_output_close(output);
   }
 
 #if 0
@@ -1394,7 +1408,7 @@ void CreateParmHeader() {
   //! File containing decoding structures 
   FILE *output;
 
-  if ( !(output = fopen( "ac_parms.H", "w"))){
+  if ( !(output = ac_output_open("ac_parms.H"))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -1576,7 +1590,7 @@ void CreateParmHeader() {
   fprintf( output, "\n\n");
   fprintf( output, "#endif  //_AC_PARMS_H\n");
 
-  fclose(output);
+  ac_output_close(output);
 }
 
 #endif
@@ -1599,7 +1613,7 @@ void CreateISAHeader() {
 
   sprintf( filename, "%s_isa.H", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -1686,7 +1700,7 @@ void CreateISAHeader() {
   fprintf( output,"};\n" );
   fprintf( output, "#endif //_ISA_H\n\n");
 
-  fclose( output); 
+  ac_output_close(output); 
 
 }
 
@@ -1709,7 +1723,7 @@ void CreateARCHHeader() {
   
   sprintf( filename, "%s-arch.H", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -1911,7 +1925,7 @@ void CreateARCHHeader() {
   fprintf( output,"%s};\n", INDENT[0] );
   fprintf( output, "#endif  //_ARCH_H\n\n");
 
-  fclose( output); 
+  ac_output_close(output); 
   
 }
 
@@ -1941,7 +1955,7 @@ void CreateStgHeader( ac_stg_list* stage_list, char* pipe_name) {
       sprintf( stage_filename, "%s.H", pstage->name);
     }
 
-    if ( !(output = fopen( stage_filename, "w"))){
+    if ( !(output = ac_output_open(stage_filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -2040,7 +2054,7 @@ void CreateStgHeader( ac_stg_list* stage_list, char* pipe_name) {
     fprintf( output, "}\n"); 
 
     fprintf( output, "#endif \n");
-    fclose(output);
+    ac_output_close(output);
     free(stage_filename);
   }
 }
@@ -2057,7 +2071,7 @@ void CreateProcessorHeader_old() {
   filename = (char*) malloc(strlen(project_name)+strlen(".H")+1);
   sprintf( filename, "%s.H", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2151,7 +2165,7 @@ void CreateProcessorHeader_old() {
   fprintf( output, "};\n");
   
   fprintf( output, "#endif //_%s_H\n",project_name );
-  fclose(output);
+  ac_output_close(output);
   free(filename);
 }
 
@@ -2175,7 +2189,7 @@ void CreateRegsHeader() {
     if(( pstorage->type == REG ) && (pstorage->format != NULL )){
 
       if(flag){  //Print this just once.
-        if ( !(output = fopen( filename, "w"))){
+        if ( !(output = ac_output_open(filename))){
           perror("ArchC could not open output file");
           exit(1);
         }
@@ -2229,7 +2243,7 @@ void CreateRegsHeader() {
 
   if(!flag){ //We had at last one formatted reg declared.
     fprintf( output, "#endif //_AC_FMT_REGS_H\n");
-    fclose(output);
+    ac_output_close(output);
   }
 }
 
@@ -2246,7 +2260,7 @@ void CreateCoverifHeader(void){
 
 
   
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2360,7 +2374,7 @@ void CreateCoverifHeader(void){
 
   //END OF FILE!
   fprintf( output, "#endif //_AC_VERIFY_H\n");
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -2377,7 +2391,7 @@ void CreateStatsHeader(void){
 
 
   
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2546,7 +2560,7 @@ void CreateStatsHeader(void){
 
   //END OF FILE!
   fprintf( output, "#endif //_AC_STATS_H\n");
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -2576,7 +2590,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name) {
       sprintf( stage_filename, "%s.cpp", pstage->name);
     }
 
-    if ( !(output = fopen( stage_filename, "w"))){
+    if ( !(output = ac_output_open(stage_filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -2642,7 +2656,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name) {
                         
       if( ACDebugFlag ){
         fprintf( output, "%sextern bool ac_do_trace;\n", INDENT[1]);
-        fprintf( output, "%sextern ofstream trace_file;\n", INDENT[1]);
+        fprintf( output, "%sextern ac_trace_writer trace_file;\n", INDENT[1]);
       }
 
       if( ACABIFlag ){
@@ -2706,7 +2720,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name) {
       fprintf( output, "}\n\n");
     }
 
-    fclose(output);
+    ac_output_close(output);
     free(stage_filename);
   }
 }
@@ -2723,7 +2737,7 @@ void CreateProcessorImpl() {
   filename = (char*) malloc(strlen(project_name)+strlen(".cpp")+1);
   sprintf( filename, "%s.cpp", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2742,7 +2756,7 @@ void CreateProcessorImpl() {
   fprintf( output, "void %s::behavior() {\n\n", project_name);
   if( ACDebugFlag ){
     fprintf( output, "%sextern bool ac_do_trace;\n", INDENT[1]);
-    fprintf( output, "%sextern ofstream trace_file;\n", INDENT[1]);
+    fprintf( output, "%sextern ac_trace_writer trace_file;\n", INDENT[1]);
   }
   fprintf( output, "%sextern unsigned int decode_pc, quant;\n", INDENT[1]);
   fprintf( output, "%sextern unsigned char buffer[AC_MAX_BUFFER];\n", INDENT[1]);
@@ -2777,7 +2791,7 @@ void CreateProcessorImpl() {
     else
       EmitProcessorBhv(output);
   }
-  fclose(output);
+  ac_output_close(output);
   free(filename);
 }
 
@@ -2801,7 +2815,7 @@ void CreateResourceImpl() {
   char filename[] = "ac_resources.cpp";
 
   load_device= storage_list;
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3121,7 +3135,7 @@ void CreateResourceImpl() {
   COMMENT(INDENT[0],"Global aliases for resources.");
   fprintf( output, "%s\n", Globals);
 
-  fclose( output); 
+  ac_output_close(output); 
   
 }
 
@@ -3146,7 +3160,7 @@ void CreateARCHImpl() {
   FILE  *output;
   
   sprintf( filename, "%s-arch.cpp", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3282,7 +3296,7 @@ void CreateARCHImpl() {
     EmitUpdateMethod( output);
 
   //!END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 }
 
 
@@ -3296,7 +3310,7 @@ void CreateMainTmpl(){
   FILE  *output;
 
   sprintf( description, "This is the main file for the %s ArchC model", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3399,7 +3413,7 @@ void CreateImplTmpl(){
   FILE  *output;
   
   sprintf( filename, "%s-isa.cpp.tmpl", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3496,11 +3510,11 @@ void CreateImplTmpl(){
   }
   
   //!END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 
 
   //Now writing ISA initialization file.
-  if ( !(output = fopen( initfilename, "w"))){
+  if ( !(output = ac_output_open(initfilename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3522,7 +3536,7 @@ void CreateImplTmpl(){
         
   
   //!END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -3537,7 +3551,7 @@ void CreateRegsImpl() {
   char filename[] = "ac_regs.cpp.tmpl";
   char description[] = "Formatted Register Behavior implementation file.";
  
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3558,7 +3572,7 @@ void CreateRegsImpl() {
     }
   }
   //END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 }
 
 
@@ -3571,7 +3585,7 @@ void CreateArchSyscallHeader()
 
   snprintf(filename, 50, "%s_syscall.H", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3605,7 +3619,7 @@ void CreateArchSyscallHeader()
           "#endif\n"
           , project_name, project_name, project_name);
 
-  fclose( output);
+  ac_output_close(output);
 }
 
 
@@ -3624,7 +3638,7 @@ void CreateMakefile(){
 
   extern int PROCESSOR_OPTIMIZATIONS;
  
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3713,7 +3727,7 @@ void CreateMakefile(){
     fprintf( output, "$(MODULE).cpp");
   }     
 
-  fprintf( output, " $(wildcard $(MODULE)-block*.cpp)");
+  fprintf( output, " $(wildcard $(MODULE)-block*.cpp $(MODULE)-hot*.cpp)");
 
   fprintf( output, "\n\n");
  
@@ -3801,6 +3815,8 @@ void CreateMakefile(){
   fprintf( output, "OBJS := $(SRCS:.cpp=.o)\n");
 
   fprintf( output, "\n");
+  ac_make_jobs(output);
+
   //Declaring Executable name
   fprintf( output, "EXE := $(MODULE).x\n\n");
 
@@ -3809,9 +3825,14 @@ void CreateMakefile(){
 
   fprintf( output, "all: $(ACFILESHEAD) $(MODULE)_syscall.H $(ACFILES) $(EXE)\n\n");
 
+  COMMENT_MAKE("ArchC only rewrites the generated files whose contents changed, so the objects");
+  COMMENT_MAKE("of unchanged region blocks are reused. A changed header rebuilds everything");
+  fprintf( output, "$(OBJS): $(wildcard $(ACHEAD) $(ACINCS) $(if $(filter 1,$(ISA_AND_SYSCALL_TOGETHER)),$(MODULE)_isa.cpp $(MODULE)_syscall.cpp))\n\n");
+
   fprintf( output, "$(EXE): $(OBJS) %s libdummy.a\n",
            (strlen(SYSTEMC_PATH) > 2) ? "$(SYSTEMC)/lib-$(TARGET_ARCH)/libsystemc.a" : "");
-  fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) $(LIB_DIR) -o $@ $(OBJS) $(LIBS) -Xlinker --allow-multiple-definition 2>&1 | c++filt\n\n");
+  fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) $(LIB_DIR) -o $@ $(OBJS) $(LIBS) -Xlinker --allow-multiple-definition 2>&1 | c++filt\n");
+  ac_make_compile_report(output);
 
   COMMENT_MAKE("Create dummy library with possibly undefined functions");
   fprintf( output, "ACDUMMY := $(wildcard ac_dummy*.cpp)\n");
@@ -3826,8 +3847,7 @@ void CreateMakefile(){
   fprintf( output, "%s_syscall.H:\n", project_name);
   fprintf( output, "\tcp %s_syscall.H.tmpl %s_syscall.H\n\n", project_name, project_name);
 
-  fprintf( output, ".cpp.o:\n");
-  fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) -c $<\n\n");
+  ac_make_timed_rule(output, "");
 
   fprintf( output, ".cc.o:\n");
   fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) -c $<\n\n");
@@ -3835,7 +3855,7 @@ void CreateMakefile(){
   fprintf( output, "POWERPCSYSCALL=$(shell grep '\\#define %s_SYSCALL_H' %s_syscall.H )\n\n", project_name, project_name);
 
   fprintf( output, "clean:\n");
-  fprintf( output, "\trm -f $(OBJS) *~ $(EXE) core *.o libdummy.a\n");
+  fprintf( output, "\trm -f $(OBJS) *~ $(EXE) core *.o libdummy.a $(COMPILE_TIMES)\n");
   fprintf( output, "ifeq ($(POWERPCSYSCALL), )\n");
   fprintf( output, "\trm -f %s_syscall.H\n", project_name);
   fprintf( output, "endif\n\n");
@@ -3879,7 +3899,7 @@ void CreateDummy(int id, char* content) {
   char filename[30];
   sprintf( filename, "ac_dummy%d.cpp", id);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -4345,8 +4365,8 @@ void EmitUpdateMethod( FILE *output){
   fprintf( output, "%sif(!ac_wait_sig){\n", INDENT[1]);
   if( ACDelayFlag ){
     for( pstorage = storage_list; pstorage!= NULL; pstorage = pstorage->next ) 
-      fprintf( output, "%s%s.commit_delays( (double)ac_cycle_counter );\n", INDENT[2], pstorage->name);
-    fprintf( output, "%sac_pc.commit_delays(  (double)ac_cycle_counter );\n", INDENT[2]);
+      fprintf( output, "%s%s.commit_delays( ac_cycle_counter );\n", INDENT[2], pstorage->name);
+    fprintf( output, "%sac_pc.commit_delays( ac_cycle_counter );\n", INDENT[2]);
 
     fprintf( output, "%sif(!ac_parallel_sig)\n", INDENT[2]);
     fprintf( output, "%sac_cycle_counter+=1;\n", INDENT[3]);
@@ -4711,7 +4731,7 @@ void EmitPipeABIDefine( FILE *output){
 
   if( ACDebugFlag ){
     fprintf( output, "%sif( ac_do_trace != 0 )\\\n", INDENT[4]);
-    fprintf( output, "%strace_file << hex << decode_pc << dec << endl; \\\n", INDENT[5]);
+    fprintf( output, "%strace_file.instr(decode_pc, 0); \\\n", INDENT[5]);
   }
 
   fprintf( output, "%ssyscall.NAME(); \\\n", INDENT[4]);
@@ -4742,7 +4762,7 @@ void EmitABIDefine( FILE *output){
 
   if( ACDebugFlag ){
     fprintf( output, "%sif( ac_do_trace != 0 )\\\n", INDENT[4]);
-    fprintf( output, "%strace_file << hex << decode_pc << dec << endl; \\\n", INDENT[5]);
+    fprintf( output, "%strace_file.instr(decode_pc, 0); \\\n", INDENT[5]);
   }
 
   fprintf( output, "%ssyscall.NAME(); \\\n", INDENT[4]);
@@ -41,6 +41,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "ac_decoder.h"
+#include "ac_output.h"
 
 /*Defining indentation */
 #define INDENT0  ""
@@ -112,6 +113,7 @@ enum _ac_cmd_options {
   OPOptimization,
 /*  OPInline, */
   OPRegionBlockSize,
+  OPProfile,
   OPMulticore, 
   OPAnnulSig,
 /*   OPP4, */
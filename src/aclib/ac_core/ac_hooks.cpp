@@ -0,0 +1,123 @@
+/**
+ * @file      ac_hooks.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Instrumentation hooks.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+#include "ac_hooks.H"
+
+void ac_hooks::add_pc(unsigned pc, ac_instr_hook hook, void* data)
+{
+  instr_entry e = { hook, data };
+  pc_hooks.insert(std::make_pair(pc, e));
+}
+
+void ac_hooks::remove_pc(unsigned pc, ac_instr_hook hook, void* data)
+{
+  std::multimap<unsigned, instr_entry>::iterator it = pc_hooks.lower_bound(pc);
+
+  while ((it != pc_hooks.end()) && (it->first == pc)) {
+    if ((it->second.hook == hook) && (it->second.data == data))
+      pc_hooks.erase(it++);
+    else
+      ++it;
+  }
+}
+
+void ac_hooks::add_instr(unsigned id, ac_instr_hook hook, void* data)
+{
+  instr_entry e = { hook, data };
+
+  if (id >= id_hooks.size())
+    id_hooks.resize(id + 1);
+  id_hooks[id].push_back(e);
+  n_id_hooks++;
+}
+
+void ac_hooks::remove_instr(unsigned id, ac_instr_hook hook, void* data)
+{
+  if (id >= id_hooks.size())
+    return;
+  for (unsigned i = 0; i < id_hooks[id].size(); )
+    if ((id_hooks[id][i].hook == hook) && (id_hooks[id][i].data == data)) {
+      id_hooks[id].erase(id_hooks[id].begin() + i);
+      n_id_hooks--;
+    }
+    else
+      i++;
+}
+
+void ac_hooks::bounds()
+{
+  mem_lo = 1;
+  mem_hi = 0;
+  for (unsigned i = 0; i < mem_hooks.size(); i++) {
+    if ((i == 0) || (mem_hooks[i].lo < mem_lo))
+      mem_lo = mem_hooks[i].lo;
+    if ((i == 0) || (mem_hooks[i].hi > mem_hi))
+      mem_hi = mem_hooks[i].hi;
+  }
+}
+
+void ac_hooks::add_mem(unsigned lo, unsigned hi, ac_mem_hook hook, void* data)
+{
+  mem_entry e = { lo, hi, hook, data };
+
+  mem_hooks.push_back(e);
+  bounds();
+}
+
+void ac_hooks::remove_mem(unsigned lo, unsigned hi, ac_mem_hook hook, void* data)
+{
+  for (unsigned i = 0; i < mem_hooks.size(); )
+    if ((mem_hooks[i].lo == lo) && (mem_hooks[i].hi == hi) &&
+        (mem_hooks[i].hook == hook) && (mem_hooks[i].data == data))
+      mem_hooks.erase(mem_hooks.begin() + i);
+    else
+      i++;
+  bounds();
+}
+
+bool ac_hooks::hooked(unsigned pc, unsigned id) const
+{
+  return (pc_hooks.find(pc) != pc_hooks.end()) ||
+    ((id < id_hooks.size()) && !id_hooks[id].empty());
+}
+
+bool ac_hooks::run(unsigned pc, unsigned id)
+{
+  std::vector<instr_entry> hooks;
+  bool skip = false;
+
+  // Copied first, as a hook may remove itself
+  for (std::multimap<unsigned, instr_entry>::iterator it = pc_hooks.lower_bound(pc);
+       (it != pc_hooks.end()) && (it->first == pc); ++it)
+    hooks.push_back(it->second);
+  if (id < id_hooks.size())
+    hooks.insert(hooks.end(), id_hooks[id].begin(), id_hooks[id].end());
+
+  for (unsigned i = 0; i < hooks.size(); i++)
+    if (hooks[i].hook(hooks[i].data, pc, id))
+      skip = true;
+  return skip;
+}
+
+void ac_hooks::access(unsigned address, unsigned size, bool write)
+{
+  unsigned last = address + size - 1;
+
+  for (unsigned i = 0; i < mem_hooks.size(); i++)
+    if ((address <= mem_hooks[i].hi) && (last >= mem_hooks[i].lo))
+      mem_hooks[i].hook(mem_hooks[i].data, address, size, write);
+}
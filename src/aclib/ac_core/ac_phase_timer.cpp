@@ -0,0 +1,100 @@
+/**
+ * @file      ac_phase_timer.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Host time spent by a processor simulator in each phase.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+#include <stdio.h>
+#include "ac_phase_timer.H"
+
+static const char *phase_names[ac_phase_timer::NUMBER] = {
+  "other", "decode", "behavior", "memory", "syscall", "wait"
+};
+
+std::vector<ac_phase_timer*> ac_phase_timer::timers;
+
+ac_phase_timer::ac_phase_timer() :
+  current(OTHER), countdown(AC_PHASE_SAMPLE_PERIOD), seed(1), measuring(false),
+  sample_start(0), start_ticks(0), name(0) {
+  for (int p = 0; p < NUMBER; p++)
+    count[p] = sampled[p] = sampled_ticks[p] = 0;
+}
+
+void ac_phase_timer::start(const char *n) {
+  name = n;
+  start_ticks = ticks();
+  gettimeofday(&start_time, NULL);
+  timers.push_back(this);
+}
+
+void ac_phase_timer::sample() {
+  // Random distance to the next sample, so that it does not follow the
+  // period of the simulation loop
+  seed = seed * 1103515245u + 12345u;
+  countdown = AC_PHASE_SAMPLE_PERIOD / 2 + (seed >> 16) % AC_PHASE_SAMPLE_PERIOD;
+  measuring = true;
+  sample_start = ticks();
+}
+
+void ac_phase_timer::estimate(double *seconds) const {
+  struct timeval now;
+  double elapsed, ticks_per_second;
+
+  gettimeofday(&now, NULL);
+  elapsed = (now.tv_sec - start_time.tv_sec) + (now.tv_usec - start_time.tv_usec) / 1e6;
+  ticks_per_second = (elapsed > 0) ? (ticks() - start_ticks) / elapsed : 1;
+
+  for (int p = 0; p < NUMBER; p++)
+    seconds[p] = sampled[p] ?
+      count[p] * ((double) sampled_ticks[p] / sampled[p]) / ticks_per_second : 0;
+}
+
+void ac_phase_timer::dump(std::ostream &out) const {
+  double seconds[NUMBER], total = 0;
+  unsigned long long samples = 0;
+  char line[128];
+
+  if (!name)
+    return;
+  estimate(seconds);
+  for (int p = 0; p < NUMBER; p++) {
+    total += seconds[p];
+    samples += sampled[p];
+  }
+
+  out << "    Host time by phase (" << name << ", " << samples << " samples):\n";
+  for (int p = 0; p < NUMBER; p++)
+    if (count[p]) {
+      snprintf(line, sizeof(line), "    Phase %s: %.3f s (%.1f%%)\n", phase_names[p],
+               seconds[p], total > 0 ? seconds[p] * 100 / total : 0);
+      out << line;
+    }
+}
+
+void ac_phase_timer::dump_folded(const char *path) {
+  FILE *f = fopen(path, "w");
+
+  if (f == NULL) {
+    fprintf(stderr, "ArchC: Could not write the phase times to '%s'.\n", path);
+    return;
+  }
+  for (unsigned i = 0; i < timers.size(); i++) {
+    double seconds[NUMBER];
+    timers[i]->estimate(seconds);
+    for (int p = 0; p < NUMBER; p++)
+      if (seconds[p] > 0)
+        fprintf(f, "%s;%s %.0f\n", timers[i]->name, phase_names[p], seconds[p] * 1e6);
+  }
+  fclose(f);
+}
@@ -19,6 +19,7 @@
 #include "ac_sighandlers.H"
 #include <stdlib.h>
 #include "ac_module.H"
+#include "ac_profiler.H"
 
 void sigint_handler(int signal)
 {
@@ -35,7 +36,9 @@ void sigsegv_handler(int signal)
 void sigusr1_handler(int signal)
 {
   fprintf(stderr, "ArchC: Received signal %d. Printing statistics\n", signal);
+  ac_profile_defer = 1;
   ac_module::PrintAllStats();
+  ac_profile_defer = 0;
   fprintf(stderr, "ArchC: -------------------- Continuing Simulation ------------------\n");
 }
 
@@ -337,33 +337,28 @@ ac_decoder_full *ac_decoder_full::CreateDecoder(ac_dec_format *formats, ac_dec_i
   full -> instructions = instructions;
   full -> nFields = nFields;
   full -> prog_source = source;
+  full -> result = 0;
   
   return full;
 }
 
-unsigned* ac_decoder_full::Decode(unsigned char *buffer, int quant)
+bool ac_decoder_full::Decode(unsigned char *buffer, int quant, unsigned *operands) const
 {
-  ac_decoder_full *decoder = this;
-  ac_decoder *d = decoder -> decoder;
+  ac_decoder *d = decoder;
   ac_dec_field *field = 0;
-  long long field_value;
+  long long field_value = 0;
   ac_dec_instr *instruction = NULL;
-  //char byte;
-  static unsigned *fields = 0;
 
-  ac_decoder *chosenPath[64]; // usar uma constante = MAX_DECODER_DEPTH
+  ac_decoder *chosenPath[AC_DEC_MAX_DEPTH];
   int chosenPathPos = 0;
   chosenPath[chosenPathPos] = d;
 
- //!Allocate the first time only
-  if (!fields) {
-    fields = new unsigned[decoder -> nFields];
-  }
+  operands[0] = 0;
 
   while (d) {
     if (!field) {
-      field = decoder->fields->FindDecField(d -> check -> id);
-      field_value = decoder->prog_source->GetBits(buffer, &quant, field -> first_bit, field -> size, field -> sign);
+      field = GetField(d -> check -> id);
+      field_value = prog_source->GetBits(buffer, &quant, field -> first_bit, field -> size, field -> sign);
     }
 
     //fprintf(stderr, "Decoder - FieldName: %s ValueRequired: %d ValueFound: %d\n",
@@ -372,15 +367,18 @@ unsigned* ac_decoder_full::Decode(unsigned char *buffer, int quant)
     if (field_value == d -> check -> value) {
       if (d -> found) {
         //fprintf(stderr, "Instruction %s has been found.\n", d -> found -> name);
-        fields[d->check->id] = field_value;
+        operands[d->check->id] = field_value;
         instruction = d->found;
         break;
-      } else {
+      } else if (chosenPathPos + 1 < AC_DEC_MAX_DEPTH) {
         //fprintf(stderr, "Following d -> subcheck branch in the decoder tree. \n");
         chosenPath[++chosenPathPos] = d -> subcheck;
-        fields[d->check->id] = field_value;
+        operands[d->check->id] = field_value;
         d = d -> subcheck;
         field = 0;
+      } else {
+        fprintf(stderr, "Error: Decoder tree deeper than %d levels.\n", AC_DEC_MAX_DEPTH);
+        exit(1);
       }
     } else {
       //fprintf(stderr, "Following d->next branch in the decoder tree. \n");
@@ -404,16 +402,24 @@ unsigned* ac_decoder_full::Decode(unsigned char *buffer, int quant)
   if (instruction != NULL) {
     d = d->subcheck;
     while (d) {
-      field = decoder->fields->FindDecField(d -> check -> id);
-      field_value = decoder->prog_source->GetBits(buffer, &quant, field -> first_bit, field -> size, field -> sign);
-      fields[d->check->id] = field_value;
+      field = GetField(d -> check -> id);
+      operands[d->check->id] = prog_source->GetBits(buffer, &quant, field -> first_bit, field -> size, field -> sign);
       d = d->subcheck;
     }
-    fields[0] = instruction->id;
-    return fields;
+    operands[0] = instruction->id;
+    return true;
   }
 
-  return NULL;
+  return false;
+}
+
+unsigned* ac_decoder_full::Decode(unsigned char *buffer, int quant)
+{
+  //!Allocate the first time only
+  if (!result)
+    result = new unsigned[nFields];
+
+  return Decode(buffer, quant, result) ? result : NULL;
 }
 
 // ac_dec_format method?
@@ -0,0 +1,216 @@
+/**
+ * @file      ac_decoder_stress.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Stress test of the reentrant runtime decoder.
+ *
+ *            Builds the decoder of a small MIPS-like ISA, decodes a random
+ *            instruction stream serially, then decodes the same stream
+ *            with one shared decoder on several threads at once and
+ *            compares every operand record with the serial one. Built with
+ *            "make ac_decoder_stress" in src/aclib.
+ *
+ *            Usage: ac_decoder_stress [threads] [instructions] [rounds]
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <vector>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_decoder_rt.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// Program source reading big endian 32-bit words that are already in the
+/// buffer. It keeps no state, so it can be shared by all the threads.
+class stress_source : public ac_dec_prog_source {
+public:
+  unsigned long long GetBits(unsigned char* buffer, int* quant, int last,
+                             int quantity, int sign) {
+    unsigned word = *(unsigned*) buffer;
+    unsigned long long value = word >> (31 - last);
+
+    value &= ((unsigned)(~0LL)) >> (64 - ((unsigned) quantity));
+    if (sign && (value >= (unsigned)(1 << (quantity - 1))))
+      value |= (~0LL) << quantity;
+    return value;
+  }
+};
+
+// Fields are numbered from the most significant bit, first_bit is the last
+// bit of the field, as acpp numbers them.
+static ac_dec_field fields[] = {
+  // Type_R
+  {"op", 6, 5, 0, 0, 0, &fields[1]},
+  {"rs", 5, 10, 0, 0, 0, &fields[2]},
+  {"rt", 5, 15, 0, 0, 0, &fields[3]},
+  {"rd", 5, 20, 0, 0, 0, &fields[4]},
+  {"shamt", 5, 25, 0, 0, 0, &fields[5]},
+  {"func", 6, 31, 0, 0, 0, NULL},
+  // Type_I
+  {"op", 6, 5, 0, 0, 0, &fields[7]},
+  {"rs", 5, 10, 0, 0, 0, &fields[8]},
+  {"rt", 5, 15, 0, 0, 0, &fields[9]},
+  {"imm", 16, 31, 0, 0, 1, NULL},
+  // Type_J
+  {"op", 6, 5, 0, 0, 0, &fields[11]},
+  {"addr", 26, 31, 0, 0, 0, NULL}
+};
+
+static ac_dec_format formats[] = {
+  {"Type_R", 32, &fields[0], &formats[1]},
+  {"Type_I", 32, &fields[6], &formats[2]},
+  {"Type_J", 32, &fields[10], NULL}
+};
+
+static ac_dec_list dec_list[] = {
+  {"op", 0, 0x00, &dec_list[1]}, {"func", 0, 0x20, NULL},   // add
+  {"op", 0, 0x00, &dec_list[3]}, {"func", 0, 0x22, NULL},   // sub
+  {"op", 0, 0x00, &dec_list[5]}, {"func", 0, 0x24, NULL},   // and
+  {"op", 0, 0x00, &dec_list[7]}, {"func", 0, 0x25, NULL},   // or
+  {"op", 0, 0x00, &dec_list[9]}, {"func", 0, 0x2a, NULL},   // slt
+  {"op", 0, 0x00, &dec_list[11]}, {"func", 0, 0x00, NULL},  // sll
+  {"op", 0, 0x08, NULL},                                    // addi
+  {"op", 0, 0x23, NULL},                                    // lw
+  {"op", 0, 0x2b, NULL},                                    // sw
+  {"op", 0, 0x04, NULL},                                    // beq
+  {"op", 0, 0x02, NULL},                                    // j
+  {"op", 0, 0x03, NULL},                                    // jal
+  {"op", 0, 0x01, &dec_list[19]}, {"rt", 0, 0x00, NULL},    // bltz
+  {"op", 0, 0x01, &dec_list[21]}, {"rt", 0, 0x01, NULL}     // bgez
+};
+
+#define STRESS_INSTR(n, name, format, list) \
+  {name, 0, name, name, format, n, 1, 1, 1, &dec_list[list], NULL, &instructions[n]}
+
+static ac_dec_instr instructions[] = {
+  STRESS_INSTR(1, "add", "Type_R", 0),
+  STRESS_INSTR(2, "sub", "Type_R", 2),
+  STRESS_INSTR(3, "and", "Type_R", 4),
+  STRESS_INSTR(4, "or", "Type_R", 6),
+  STRESS_INSTR(5, "slt", "Type_R", 8),
+  STRESS_INSTR(6, "sll", "Type_R", 10),
+  STRESS_INSTR(7, "addi", "Type_I", 12),
+  STRESS_INSTR(8, "lw", "Type_I", 13),
+  STRESS_INSTR(9, "sw", "Type_I", 14),
+  STRESS_INSTR(10, "beq", "Type_I", 15),
+  STRESS_INSTR(11, "j", "Type_J", 16),
+  STRESS_INSTR(12, "jal", "Type_J", 17),
+  STRESS_INSTR(13, "bltz", "Type_I", 18),
+  {"bgez", 0, "bgez", "bgez", "Type_I", 14, 1, 1, 1, &dec_list[20], NULL, NULL}
+};
+
+/// Opcodes and functions that decode, so that most of the stream is valid.
+static const unsigned valid_ops[] = {0x00, 0x08, 0x23, 0x2b, 0x04, 0x02, 0x03, 0x01};
+static const unsigned valid_funcs[] = {0x20, 0x22, 0x24, 0x25, 0x2a, 0x00};
+
+static ac_decoder_full* decoder;
+static std::vector<unsigned> stream;
+static std::vector<unsigned> reference;
+static unsigned rounds;
+
+/// Random instruction word, valid three times out of four.
+static unsigned random_instr(unsigned* seed) {
+  unsigned word = (rand_r(seed) << 16) ^ rand_r(seed);
+
+  if (rand_r(seed) % 4) {
+    word = (word & 0x03ffffff) | (valid_ops[rand_r(seed) % 8] << 26);
+    if ((word >> 26) == 0x00)
+      word = (word & ~0x3f) | valid_funcs[rand_r(seed) % 6];
+    else if ((word >> 26) == 0x01)
+      word = (word & ~0x001f0000) | ((rand_r(seed) % 2) << 16);
+  }
+  return word;
+}
+
+/// Decodes instruction i into operands, cleared first so that fields left
+/// unwritten by a failed decode compare equal.
+static void decode(unsigned i, unsigned* operands) {
+  memset(operands, 0, sizeof(unsigned) * decoder->nFields);
+  decoder->Decode((unsigned char*) &stream[i], 1, operands);
+}
+
+/// Decodes the whole stream rounds times and counts the mismatches.
+static void* worker(void* arg) {
+  std::vector<unsigned> operands(decoder->nFields);
+  unsigned long mismatches = 0;
+
+  for (unsigned r = 0; r < rounds; r++)
+    for (unsigned i = 0; i < stream.size(); i++) {
+      decode(i, &operands[0]);
+      if (memcmp(&operands[0], &reference[i * decoder->nFields],
+                 sizeof(unsigned) * decoder->nFields))
+        mismatches++;
+    }
+  *(unsigned long*) arg = mismatches;
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned nthreads = (argc > 1) ? strtoul(argv[1], NULL, 0) : 8;
+  unsigned n = (argc > 2) ? strtoul(argv[2], NULL, 0) : 100000;
+  unsigned seed = 1;
+  stress_source source;
+  unsigned long total = 0, valid = 0;
+
+  rounds = (argc > 3) ? strtoul(argv[3], NULL, 0) : 20;
+  if ((nthreads == 0) || (n == 0)) {
+    fprintf(stderr, "Usage: %s [threads] [instructions] [rounds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  decoder = ac_decoder_full::CreateDecoder(formats, instructions, &source);
+
+  stream.resize(n);
+  reference.resize(n * decoder->nFields);
+  for (unsigned i = 0; i < n; i++) {
+    stream[i] = random_instr(&seed);
+    decode(i, &reference[i * decoder->nFields]);
+    if (reference[i * decoder->nFields])
+      valid++;
+  }
+
+  // The serial decode must agree with the non-reentrant interface
+  for (unsigned i = 0; i < n; i++) {
+    unsigned* ops = decoder->Decode((unsigned char*) &stream[i], 1);
+    if ((ops == NULL) != (reference[i * decoder->nFields] == 0) ||
+        (ops && (ops[0] != reference[i * decoder->nFields]))) {
+      fprintf(stderr, "Instruction 0x%08x: the two decoder interfaces disagree.\n", stream[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<pthread_t> threads(nthreads);
+  std::vector<unsigned long> mismatches(nthreads);
+  for (unsigned t = 0; t < nthreads; t++)
+    if (pthread_create(&threads[t], NULL, worker, &mismatches[t]) != 0) {
+      perror("Could not start a decoder thread");
+      return EXIT_FAILURE;
+    }
+  for (unsigned t = 0; t < nthreads; t++) {
+    pthread_join(threads[t], NULL);
+    total += mismatches[t];
+  }
+
+  printf("%u threads x %u rounds x %u instructions (%lu valid): %lu mismatches\n",
+         nthreads, rounds, n, valid, total);
+  return total ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -39,6 +39,7 @@ namespace ac_dynlink {
     initiated = false;
     glibc = false;
     word_size = 0;
+    cache_key = 0;
   }
   
   ac_rtld::~ac_rtld() {
@@ -101,6 +102,8 @@ namespace ac_dynlink {
   unsigned *ac_rtld::get_init_array() {
     if (root != NULL)
       return root->get_start_vector();
+    else if (!cached_initvec.empty())
+      return &cached_initvec[0];
     else
       return NULL;
   }
@@ -109,12 +112,14 @@ namespace ac_dynlink {
     if (root != NULL)
       return root->get_start_vector_n();
     else
-      return 0;
+      return cached_initvec.size();
   }
 
   unsigned *ac_rtld::get_fini_array() {
     if (root != NULL)
       return root->get_fini_vector();
+    else if (!cached_finivec.empty())
+      return &cached_finivec[0];
     else
       return NULL;
   }
@@ -123,16 +128,20 @@ namespace ac_dynlink {
     if (root != NULL)
       return root->get_fini_vector_n();
     else
-      return 0;
+      return cached_finivec.size();
   }
 
   void  ac_rtld::set_init_arraysz(unsigned value) {
     if (root != NULL)
       root->set_start_vector_n(value);
+    else if (value < cached_initvec.size())
+      cached_initvec.resize(value);
   }
   void  ac_rtld::set_fini_arraysz(unsigned value) {
     if (root != NULL)
       root->set_fini_vector_n(value);
+    else if (value < cached_finivec.size())
+      cached_finivec.resize(value);
   }
 
   /* Initiate the run time dynamic linker */
@@ -143,6 +152,8 @@ namespace ac_dynlink {
       mem_map.add_region(start_addr, size);
       mem_map.set_brk_addr(brkaddr);
       detect_static_glibc(fd, match_endian);
+      if (ac_prelink_cache_dir)
+        compute_cache_key(fd, memsize, match_endian);
     }
   }
     
@@ -154,6 +165,10 @@ namespace ac_dynlink {
     unsigned *initvec, initvecn;
     this->word_size = word_size;
     this->glibc = true;
+
+    /* The libraries and relocations are those of a previous run */
+    if (cache_key != 0 && load_cache(mem, mem_size, start_addr, ac_heap_ptr))
+      return;
     
     if (rtld_config.is_config_loaded())
       root = new link_node(NULL, &rtld_config);
@@ -181,6 +196,9 @@ namespace ac_dynlink {
         initvec[i] = initvec[i+1];
       initvec[i] = tmp;
     }
+
+    if (cache_key != 0)
+      store_cache(mem, mem_size, start_addr, ac_heap_ptr);
   }
   
 
@@ -371,7 +371,6 @@ namespace ac_dynlink {
   {
     unsigned int i;
     Elf32_Sym *elf_symbol;
-    symbol_wrapper *symbol;
     unsigned char symbol_info;
     
     if (load_addr == 0)
@@ -382,17 +381,15 @@ namespace ac_dynlink {
 	 i++)
       {
 	elf_symbol = dyn_table.get_symbol(i);
-	symbol = new symbol_wrapper(elf_symbol, match_endian);
-	symbol_info = symbol->read_info();
+	symbol_wrapper symbol(elf_symbol, match_endian);
+	symbol_info = symbol.read_info();
 	
 	if (ELF32_ST_TYPE(symbol_info) > STT_FUNC &&
 	    ELF32_ST_TYPE(symbol_info) != STT_COMMON) {
-	  delete symbol;
 	  continue; /* Not a symbol type we need to adjust */
 	}
 	
-	if (symbol->read_section_ndx() == SHN_UNDEF) {
-	  delete symbol;
+	if (symbol.read_section_ndx() == SHN_UNDEF) {
 	  continue;  /* Symbol is undefined, no need to adjust */
 	}
 	
@@ -401,38 +398,35 @@ namespace ac_dynlink {
 	  { /* Check if the root node (exec file) has a copy
 	       relocation against this symbol. */
 	    Elf32_Addr targetaddr =
-	      root->find_copy_relocation(dyn_table.get_name(symbol->read_name_ndx()));
+	      root->find_copy_relocation(dyn_table.get_name(symbol.read_name_ndx()));
 	    if (targetaddr != 0) /* There is a copy relocation */
 	      {
                 Elf32_Addr sourceaddr;
                 Elf32_Word symsize;
                 /* We need to change this symbol location. Later,
                  after all relocations have been applied, we copy. */
-                sourceaddr = symbol->read_value();
+                sourceaddr = symbol.read_value();
                 sourceaddr += load_addr;
-                symsize = symbol->read_size();
+                symsize = symbol.read_size();
                 schedule_copy (mem+targetaddr, mem+sourceaddr, symsize);
-		symbol->write_value(targetaddr);
-		delete symbol;
+		symbol.write_value(targetaddr);
 		continue;
 	      }
 	  }
 	
 	/* Adjust its value */
-	symbol->write_value(symbol->read_value() + load_addr);
-	
-	delete symbol;
+	symbol.write_value(symbol.read_value() + load_addr);
       } /* for(i=0; i<dyn_table.get_num_symbols();i++) */
   } /* adjust_symbols() */
 
-  void link_node::patch_rtld_global(symbol_wrapper *symbol) {
+  void link_node::patch_rtld_global(symbol_wrapper &symbol) {
     if (!_rtld_global_patched) {
       _rtld_global_patched = true;
 
-      Elf32_Addr saddr = symbol->read_value();
+      Elf32_Addr saddr = symbol.read_value();
       saddr += 984;
       (*(unsigned*)(mem + saddr)) = 0x88;
-      saddr = symbol->read_value();
+      saddr = symbol.read_value();
       saddr += 988;
       (*(unsigned*)(mem + saddr)) = 0x88;
     }
@@ -448,7 +442,6 @@ namespace ac_dynlink {
     link_node *p = root;
     unsigned int symhash = dyn_table.elf_hash(name);
     Elf32_Sym *the_symbol = NULL, *weak_sym = NULL;
-    symbol_wrapper *symbol;
 
     if (exclude_root == true)
       p = p->get_next();
@@ -457,13 +450,12 @@ namespace ac_dynlink {
       {
 	the_symbol = p->lookup_local_symbol(symhash, name, vername, verhash);
         if (the_symbol != NULL) {
-          symbol = new symbol_wrapper(the_symbol, match_endian);
-          if (ELF32_ST_BIND(symbol->read_info()) == STB_WEAK) {
+          symbol_wrapper symbol(the_symbol, match_endian);
+          if (ELF32_ST_BIND(symbol.read_info()) == STB_WEAK) {
             if (weak_sym == NULL)
               weak_sym = the_symbol;
             the_symbol = NULL;
           }
-          delete symbol;
         }
 	if (the_symbol != NULL)
 	  break;
@@ -472,13 +464,11 @@ namespace ac_dynlink {
 
     /* Hook for special symbols */
     if (the_symbol != NULL) {
-      symbol = new symbol_wrapper(the_symbol, match_endian);
+      symbol_wrapper symbol(the_symbol, match_endian);
 
       if(strcmp("_rtld_global", (char*)name)==0) {
         patch_rtld_global(symbol);
       }
-
-      delete symbol;
     }
 
     
@@ -496,7 +486,6 @@ namespace ac_dynlink {
     Elf32_Word info, verhash;
     Elf_Symndx symndx;
     Elf32_Sym *elf_symbol, *def_elf_symbol;
-    symbol_wrapper *symbol, *def_symbol;
     char *vername;
     unsigned char symbol_info = 0, weak = 0;
     
@@ -510,18 +499,16 @@ namespace ac_dynlink {
 	info = dyn_relocs.read_info(i);
 	symndx = ELF32_R_SYM(info);
 	elf_symbol = dyn_table.get_symbol(symndx);
-	symbol = new symbol_wrapper(elf_symbol, match_endian);
-	symbol_info = symbol->read_info();
+	symbol_wrapper symbol(elf_symbol, match_endian);
+	symbol_info = symbol.read_info();
 	
 	if (ELF32_ST_TYPE(symbol_info) > STT_FUNC &&
 	    ELF32_ST_TYPE(symbol_info) != STT_COMMON) {
-	  delete symbol;
 	  continue; /* Not a symbol type we need to resolve */
 	}
 	
 	if (ELF32_ST_BIND(symbol_info) == STB_LOCAL ||
 	    ELF32_ST_BIND(symbol_info) > STB_WEAK) {
-	  delete symbol;
 	  continue; /* Not global or weak */
 	}
 	
@@ -529,8 +516,7 @@ namespace ac_dynlink {
 	  weak = 1;
 	}
 	
-	if (symbol->read_section_ndx() != SHN_UNDEF) {
-	    delete symbol;
+	if (symbol.read_section_ndx() != SHN_UNDEF) {
 	    continue;  /* Symbol is not undefined, no need to resolve */
 	}
 	
@@ -545,29 +531,26 @@ namespace ac_dynlink {
 	  }
 	
 	def_elf_symbol = NULL;
-        def_elf_symbol = find_symbol(dyn_table.get_name(symbol->read_name_ndx()), vername, verhash, false);
+        def_elf_symbol = find_symbol(dyn_table.get_name(symbol.read_name_ndx()), vername, verhash, false);
 	
 	if (def_elf_symbol == NULL)  /* Symbol not found. */
 	  {
 	    if (weak) {
-	      delete symbol;
 	      continue; /* Definition for this symbol is not a problem */	      
 	    }
 	    AC_ERROR("Run-time dynamic linker: Symbol \"" << 
-		     dyn_table.get_name(symbol->read_name_ndx()) << "\" unknown.");
+		     dyn_table.get_name(symbol.read_name_ndx()) << "\" unknown.");
 	    exit(EXIT_FAILURE);
 	  }
 	
 	/* Symbol found */
-	def_symbol = new symbol_wrapper(def_elf_symbol, match_endian);
-	symbol->write_value(def_symbol->read_value());
-	symbol->write_size(def_symbol->read_size());
-	symbol->write_section_ndx(def_symbol->read_section_ndx());
-	symbol->write_info(def_symbol->read_info());
+	symbol_wrapper def_symbol(def_elf_symbol, match_endian);
+	symbol.write_value(def_symbol.read_value());
+	symbol.write_size(def_symbol.read_size());
+	symbol.write_section_ndx(def_symbol.read_section_ndx());
+	symbol.write_info(def_symbol.read_info());
 	
 	/* Done */
-	delete def_symbol;
-	delete symbol;
       } /* for(i=0;i<dyn_relocs.get_size();i++) */
   } /* resolve_symbols() */
 
@@ -587,7 +570,6 @@ namespace ac_dynlink {
     Elf32_Word info;
     Elf_Symndx symndx;
     Elf32_Sym *elf_symbol;
-    symbol_wrapper *symbol;
     unsigned char *refname;
     
     if (!has_relocations)
@@ -604,9 +586,8 @@ namespace ac_dynlink {
 	  continue; /* Not a copy relocation */
 	symndx = ELF32_R_SYM(info);
 	elf_symbol = dyn_table.get_symbol(symndx);
-	symbol = new symbol_wrapper(elf_symbol, match_endian);
-	refname = dyn_table.get_name(symbol->read_name_ndx());
-	delete symbol;
+	symbol_wrapper symbol(elf_symbol, match_endian);
+	refname = dyn_table.get_name(symbol.read_name_ndx());
 	if (!strcmp((char*)symname,(char *)refname)) /* Matches */
 	  return dyn_relocs.read_offset(i) + load_addr;
       }
@@ -642,7 +623,6 @@ namespace ac_dynlink {
     Elf32_Addr target, location;
     Elf_Symndx symndx;
     Elf32_Sym *elf_symbol;
-    symbol_wrapper *symbol;
     Elf32_Word symsize;
     
     if (!has_relocations)
@@ -657,10 +637,9 @@ namespace ac_dynlink {
 	info = dyn_relocs.read_info(i);
 	symndx = ELF32_R_SYM(info);
 	elf_symbol = dyn_table.get_symbol(symndx);
-	symbol = new symbol_wrapper(elf_symbol, match_endian);
-	target = symbol->read_value();
-	symsize = symbol->read_size();
-	delete symbol;
+	symbol_wrapper symbol(elf_symbol, match_endian);
+	target = symbol.read_value();
+	symsize = symbol.read_size();
 	target += dyn_relocs.read_addend(i);
 	location = dyn_relocs.read_offset(i);
 	location += load_addr;
@@ -14,7 +14,7 @@
  * @version   1.0
  * @date      Mon, 19 Jun 2006 15:33:19 -0300
  *
- * @brief     memmap and related classes implementation
+ * @brief     memmap class implementation
  *            Manages free memory space
  *
  * @attention Copyright (C) 2002-2009 --- The ArchC Team
@@ -32,105 +32,76 @@
 namespace ac_dynlink {
 
   /*
-     memmap_node class methods
-   */
-  /* 
-     Default constructor
+     memmap class methods
    */
-  memmap_node::memmap_node(memmap_node * _next, memmap_status _status, Elf32_Addr _addr):
-    next(_next),
-    status(_status),
-    addr(_addr) {
-  }
-    
-  memmap_node* memmap_node::get_next() {
-    return next;
-  }
-    
-  Elf32_Addr memmap_node::get_addr() {
-    return addr;
-  }
-    
-  memmap_status memmap_node::get_status() {
-    return status;
-  }
+  void memmap::split_at(Elf32_Addr addr) {
+    region_map::iterator it = regions.upper_bound(addr);
 
-  void memmap_node::set_status(memmap_status value) {
-    status = value;
+    if (it == regions.begin())
+      return;
+    --it;
+    if (it->first < addr && it->second.end > addr) {
+      memmap_region upper = it->second;
+      it->second.end = addr;
+      regions[addr] = upper;
+    }
   }
 
-  void memmap_node::set_next(memmap_node *next) {
-    this->next = next;
-  }
-   
-  /*
-     memmap class methods
-   */
-  void memmap::delete_node(memmap_node *node) {
-    memmap_node *aux = list, *prior = NULL;
-    
-    while (aux != NULL && aux != node){
-      prior = aux;
-      aux = aux->get_next();
-    }
-    if (node == list) {
-      aux = list->get_next();
-      delete list;
-      list = aux;
-    } else {
-      memmap_node *aux2 = aux->get_next();
-      delete aux;
-      prior->set_next(aux2);
-    }
+  void memmap::remove_range(Elf32_Addr start, Elf32_Addr end) {
+    if (start >= end)
+      return;
+    split_at(start);
+    split_at(end);
+    regions.erase(regions.lower_bound(start), regions.lower_bound(end));
   }
 
-  void memmap::fix_consistency() {
-    memmap_node *aux = list->get_next(), *prior=list;
-    
-    /* fixes misplaced nodes */
-    while (aux != NULL) {
-      if (aux->get_addr() <= prior->get_addr() &&
-	  !(aux->get_status() == MS_FREE &&
-	    prior->get_status() == MS_FREE)) {
-	if (prior == list) {
-	  list = aux;
-          delete prior;
-        } else
-          delete_node(prior);
+  void memmap::merge_around(Elf32_Addr addr) {
+    region_map::iterator it = regions.upper_bound(addr);
+
+    if (it == regions.begin())
+      return;
+    --it;
+    if (it->second.end <= addr)
+      return;
+
+    /* merges with the contiguous region before */
+    if (it != regions.begin()) {
+      region_map::iterator prior = it;
+      --prior;
+      if (prior->second.end == it->first &&
+          prior->second.prot == it->second.prot) {
+        prior->second.end = it->second.end;
+        regions.erase(it);
+        it = prior;
       }
-      prior = aux;
-      aux = aux->get_next();
     }
-    
-    /* merges contigous free block regions */
-    aux = list->get_next();
-    prior = list;
-    while (aux != NULL) {
-      if (aux->get_status() == MS_FREE &&
-	  prior->get_status() == MS_FREE) {
-	aux = aux->get_next();
-	delete_node(prior->get_next());
-      } else {
-	prior = aux;
-	aux = aux->get_next();
-      }
-    }    
+
+    /* and with the contiguous region after */
+    region_map::iterator next = it;
+    ++next;
+    if (next != regions.end() && next->first == it->second.end &&
+        next->second.prot == it->second.prot) {
+      it->second.end = next->second.end;
+      regions.erase(next);
+    }
   }
 
-  void memmap::free_memmap() {
-    memmap_node *aux = list;
-    if (list == NULL)
-      return;
-    list = list->get_next();
-    delete aux;
-    free_memmap();
+  /* End of [addr, addr + size) rounded up to a page boundary, 0 if it
+     does not fit in the address space */
+  Elf32_Addr memmap::page_end(Elf32_Addr addr, Elf32_Word size) {
+    Elf32_Addr end = addr + size;
+
+    if (end < addr)
+      return 0;
+    if (end % pagesize != 0)
+      end += pagesize - (end % pagesize);
+    return (end < addr) ? 0 : end;
   }
 
   /* 
      Default constructor
    */
   memmap::memmap() {
-      list = new memmap_node(NULL, MS_FREE, 0);
       pagesize = sysconf(_SC_PAGE_SIZE);
       brkaddr = 0;
       newbrkaddr = 0;
@@ -142,7 +113,6 @@ namespace ac_dynlink {
      Default destructor
    */
   memmap::~memmap() {
-    free_memmap();
   }
 
   void memmap::set_memsize(Elf32_Addr memsize) {
@@ -155,19 +125,21 @@ namespace ac_dynlink {
     newbrkaddr = addr;
   }
 
-  memmap_node *memmap::find_region (Elf32_Addr addr) {
-    memmap_node *aux = list;
-    
-    while (aux != NULL) {
-      if (aux->get_addr() == addr)
-	break;
-      aux = aux->get_next();
-    }
-    return aux;
+  const memmap_region *memmap::find_region (Elf32_Addr addr, Elf32_Addr *start) {
+    region_map::iterator it = regions.upper_bound(addr);
+
+    if (it == regions.begin())
+      return NULL;
+    --it;
+    if (it->second.end <= addr)
+      return NULL;
+    if (start != NULL)
+      *start = it->first;
+    return &it->second;
   }
 
-  memmap_node *memmap::add_region (Elf32_Addr start_addr, Elf32_Word size) {
-    memmap_node *aux = list, *prior = NULL;
+  void memmap::add_region (Elf32_Addr start_addr, Elf32_Word size, int prot) {
+    memmap_region region;
 
     if (start_addr + ((unsigned)size) > memsize) {
       fprintf(stderr, "ArchC memory manager error: not enough memory in target.\n");
@@ -176,28 +148,21 @@ namespace ac_dynlink {
       fprintf(stderr, " ; Total Mem Size = 0x%X\n", memsize);
       exit(EXIT_FAILURE);
     }
-    
-    while (aux != NULL && aux->get_addr() < start_addr) {
-      prior = aux;
-      aux = aux->get_next();
-    }
-    
-    if (prior == NULL) {
-      prior = aux;
-      aux = aux->get_next();
-    }
-    
-    prior->set_next(new memmap_node(new memmap_node(aux, MS_FREE, start_addr+size), MS_USED, start_addr));
-    fix_consistency();
-    
-    return find_region(start_addr);
+    if (size == 0)
+      return;
+
+    remove_range(start_addr, start_addr + size);
+    region.end = start_addr + size;
+    region.prot = prot;
+    regions[start_addr] = region;
+    merge_around(start_addr);
   }
 
 #define ALIGN_ADDR(align) ((align) - ((align) % pagesize) + pagesize)
 
   bool memmap::verify_region_availability(Elf32_Addr addr, Elf32_Word size, Elf32_Addr *next_addr)
   {
-    memmap_node *aux = list;
+    region_map::iterator it;
 
     if (addr <= ALIGN_ADDR(newbrkaddr)) {
       if (next_addr != NULL)
@@ -205,41 +170,42 @@ namespace ac_dynlink {
       return false;
     }
 
-    /* Finds the highest region address which is also lower or equal addr*/
-    while (aux->get_next() != NULL) {
-      if (aux->get_next()->get_addr() > addr)
-        break;
-      aux = aux->get_next();
-    }
     if (next_addr != NULL)
       *next_addr = 0;
-    if (aux->get_status() == MS_USED) {
-      if (next_addr != NULL && aux->get_next() != NULL)
-        *next_addr = aux->get_next()->get_addr();
-      return false; //  this region is occupied
-    } else if (aux->get_next() != NULL &&
-               aux->get_next()->get_status() == MS_USED) {
-      if (addr + ((unsigned)size) > aux->get_next()->get_addr()) {
-        if (next_addr != NULL && aux->get_next()->get_next() != NULL)
-          *next_addr = aux->get_next()->get_next()->get_addr();
-        return false; // not enough space
+
+    /* The region starting at or below addr must end before it */
+    it = regions.upper_bound(addr);
+    if (it != regions.begin()) {
+      region_map::iterator prior = it;
+      --prior;
+      if (prior->second.end > addr) {
+        if (next_addr != NULL)
+          *next_addr = prior->second.end;
+        return false; //  this region is occupied
       }
     }
-    if (addr + ((unsigned)size) > memsize)
+    /* and the next one must start after addr + size */
+    if (it != regions.end() && addr + ((unsigned)size) > it->first) {
+      if (next_addr != NULL)
+        *next_addr = it->second.end;
+      return false; // not enough space
+    }
+    if (size > memsize || addr > memsize - size)
       return false; // not enough space
     return true;
   }
   
   Elf32_Addr memmap::suggest_free_region (Elf32_Word size) {
-    memmap_node *aux = list;
+    Elf32_Addr addr;
 
-    while (aux->get_next() != NULL)
-      aux = aux->get_next();
+    if (regions.empty())
+      return 0;
 
-    if ((aux->get_addr() % pagesize) == 0)
-      return aux->get_addr();
+    addr = regions.rbegin()->second.end;
+    if ((addr % pagesize) == 0)
+      return addr;
     else {
-      return ALIGN_ADDR(aux->get_addr());
+      return ALIGN_ADDR(addr);
     }
   }
 
@@ -253,7 +219,7 @@ namespace ac_dynlink {
     /* Verify availability */
     while (!verify_region_availability(addr, size, &nextaddr)) {
       if (nextaddr != 0 && nextaddr + ((unsigned)size) < memsize)
-        addr = ALIGN_ADDR(nextaddr);
+        addr = (nextaddr % pagesize) ? ALIGN_ADDR(nextaddr) : nextaddr;
       else if (!loop) {
         loop = true;
         addr = ALIGN_ADDR(brkaddr);
@@ -268,11 +234,24 @@ namespace ac_dynlink {
     return addr;
   }
 
-  Elf32_Addr memmap::mmap_anon(Elf32_Addr addr, Elf32_Word size) {
+  Elf32_Addr memmap::mmap_anon(Elf32_Addr addr, Elf32_Word size, bool fixed, int prot) {
+    Elf32_Addr end;
 
     if (size == 0)
       return (Elf32_Addr) -1;
-    
+
+    if (fixed) {
+      end = page_end(addr, size);
+      if (addr % pagesize != 0 || end == 0 || end > memsize)
+        return (Elf32_Addr) -1;
+      add_region(addr, end - addr, prot);
+      return addr;
+    }
+
+    /* Whole pages are mapped */
+    if (size % pagesize != 0)
+      size += pagesize - (size % pagesize);
+
     /* Verify alignment */
     if (addr % pagesize != 0) {
       addr = ALIGN_ADDR(addr);
@@ -289,7 +268,7 @@ namespace ac_dynlink {
       }
     }
 
-    add_region(addr, size);
+    add_region(addr, size, prot);
 #ifdef DEBUG_MEMORY
     fprintf(stderr, "mmap region accepted: addr: %X size: %X brk: %X memsize: %X\n", addr, size, newbrkaddr, memsize);
 #endif
@@ -297,29 +276,58 @@ namespace ac_dynlink {
   }
 
   bool memmap::munmap(Elf32_Addr addr, Elf32_Word size) {
-    memmap_node* aux;
-    if (addr == 0)
+    Elf32_Addr end;
+
+    if (addr == 0 || size == 0)
       return false;
     if (addr % pagesize != 0)
       return false;
-    aux = find_region (addr);
-    if (aux == NULL)
+    end = page_end(addr, size);
+    if (end == 0)
       return false;
-    if (aux->get_next() != NULL) {
-      if (aux->get_next()->get_addr() - aux->get_addr() <= size)
-        {
-          aux->set_status(MS_FREE);
-          fix_consistency();
-        }
-    }
+    remove_range(addr, end);
 #ifdef DEBUG_MEMORY
     fprintf(stderr, "munmap region accepted: addr: %X size: %X brk: %X memsize: %X\n", addr, size, newbrkaddr, memsize);
 #endif
     return true;
   }
 
+  bool memmap::mprotect(Elf32_Addr addr, Elf32_Word size, int prot) {
+    Elf32_Addr end, covered;
+    region_map::iterator it;
+
+    if (addr % pagesize != 0)
+      return false;
+    if (size == 0)
+      return true;
+    end = page_end(addr, size);
+    if (end == 0)
+      return false;
+
+    /* Every byte of the range must be mapped */
+    if (find_region(addr, &covered) == NULL)
+      return false;
+    for (it = regions.find(covered); it != regions.end() && it->second.end < end; ++it) {
+      region_map::iterator next = it;
+      ++next;
+      if (next == regions.end() || next->first != it->second.end)
+        return false;
+    }
+
+    split_at(addr);
+    split_at(end);
+    for (it = regions.lower_bound(addr); it != regions.end() && it->first < end; ++it)
+      it->second.prot = prot;
+    merge_around(addr);
+    merge_around(end - 1);
+#ifdef DEBUG_MEMORY
+    fprintf(stderr, "mprotect region accepted: addr: %X size: %X prot: %X\n", addr, size, prot);
+#endif
+    return true;
+  }
+
   Elf32_Addr memmap::brk(Elf32_Addr addr) {
-    memmap_node *aux = list;
+    region_map::iterator it;
 
     if (addr <= brkaddr)
       return newbrkaddr;
@@ -337,15 +345,11 @@ namespace ac_dynlink {
       return newbrkaddr;
     }
 
-    /* Finds the lowest used region address which is also higher or equal newbrkaddr*/
-    while (aux != NULL) {
-      if (aux->get_addr() >= newbrkaddr && aux->get_status() == MS_USED)
-        break;
-      aux = aux->get_next();
-    }
+    /* Finds the lowest region address which is also higher or equal newbrkaddr*/
+    it = regions.lower_bound(newbrkaddr);
 
-    if (aux != NULL) { 
-      if (addr >= aux->get_addr())
+    if (it != regions.end()) { 
+      if (addr >= it->first)
         return newbrkaddr;
     }
 
@@ -357,4 +361,35 @@ namespace ac_dynlink {
     return addr;
     
   }
+
+  void memmap::save(ac_checkpoint& cp) const {
+    cp.put(brkaddr);
+    cp.put(newbrkaddr);
+    cp.put((uint32_t) regions.size());
+    for (region_map::const_iterator it = regions.begin(); it != regions.end(); ++it) {
+      cp.put(it->first);
+      cp.put(it->second.end);
+      cp.put((int32_t) it->second.prot);
+    }
+  }
+
+  void memmap::restore(ac_checkpoint& cp) {
+    uint32_t n = 0;
+
+    cp.get(brkaddr);
+    cp.get(newbrkaddr);
+    cp.get(n);
+    regions.clear();
+    for (uint32_t i = 0; cp.good() && i < n; i++) {
+      Elf32_Addr start;
+      memmap_region r;
+      int32_t prot;
+
+      cp.get(start);
+      cp.get(r.end);
+      cp.get(prot);
+      r.prot = prot;
+      regions[start] = r;
+    }
+  }
 }
@@ -0,0 +1,296 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/**
+ * @file      prelink_cache.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Cache of the linked image of dynamic applications.
+ *            After loading and linking, the memory pages written by the
+ *            loader, the init/fini vectors, the entry point and the memory
+ *            map are saved in <dir>/<key>.prelink. The key hashes the
+ *            contents of the executable, the memory size and the relocation
+ *            map; the file also lists the libraries with the hashes of
+ *            their contents, which are checked before the image is reused.
+ *            The file is only meaningful on the host that wrote it.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <string>
+#include "ac_utils.H"
+
+#include "ac_rtld.H"
+#include "link_node.H"
+#include "dynamic_info.H"
+
+#define PRELINK_MAGIC "ACPRELK1"
+#define PRELINK_PAGE 4096
+
+namespace ac_dynlink {
+
+  /* 64-bit FNV-1a */
+  static unsigned long long hash_bytes(unsigned long long h, const void *data, size_t n) {
+    const unsigned char *p = static_cast<const unsigned char*>(data);
+
+    for (size_t i = 0; i < n; i++) {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  static unsigned long long hash_file(int fd) {
+    unsigned long long h = 14695981039346656037ULL;
+    unsigned char buf[65536];
+    off_t offset = 0;
+    ssize_t n;
+
+    while ((n = pread(fd, buf, sizeof(buf), offset)) > 0) {
+      h = hash_bytes(h, buf, n);
+      offset += n;
+    }
+    return h;
+  }
+
+  static bool hash_library(const char *soname, unsigned long long *h) {
+    int fd = dynamic_info::find_library(soname);
+
+    if (fd < 0)
+      return false;
+    *h = hash_file(fd);
+    close(fd);
+    return true;
+  }
+
+  static std::string cache_path(unsigned long long key) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "/%016llx.prelink", key);
+    return std::string(ac_prelink_cache_dir) + name;
+  }
+
+  /* Pages of the image: those below the program break, in memory */
+  static unsigned image_pages(unsigned int ac_heap_ptr, Elf32_Word mem_size) {
+    unsigned pages = (ac_heap_ptr + PRELINK_PAGE - 1) / PRELINK_PAGE;
+
+    return (pages > mem_size / PRELINK_PAGE) ? mem_size / PRELINK_PAGE : pages;
+  }
+
+  static bool page_is_zero(const unsigned char *p) {
+    for (unsigned i = 0; i < PRELINK_PAGE; i++)
+      if (p[i])
+        return false;
+    return true;
+  }
+
+  template <class T> static bool get(FILE *f, T& v) {
+    return fread(&v, sizeof(T), 1, f) == 1;
+  }
+
+  template <class T> static void put(FILE *f, const T& v) {
+    fwrite(&v, sizeof(T), 1, f);
+  }
+
+  void ac_rtld::compute_cache_key(int fd, Elf32_Word memsize, bool match_endian) {
+    unsigned long long h = hash_file(fd);
+    unsigned char endian = match_endian;
+
+    h = hash_bytes(h, &memsize, sizeof(memsize));
+    h = hash_bytes(h, &endian, sizeof(endian));
+    /* Relocation codes translated by ac_rtld.relmap */
+    for (unsigned code = 0; code < 256; code++) {
+      unsigned result = code;
+      if (rtld_config.is_config_loaded() && rtld_config.translate(code, &result) == -1)
+        result = code;
+      h = hash_bytes(h, &result, sizeof(result));
+    }
+    cache_key = h ? h : 1;
+  }
+
+  bool ac_rtld::load_cache(unsigned char *mem, Elf32_Word mem_size, Elf32_Addr& start_addr,
+                           unsigned int& ac_heap_ptr) {
+    std::string path = cache_path(cache_key);
+    FILE *f = fopen(path.c_str(), "rb");
+    char magic[8];
+    unsigned long long key, h;
+    unsigned char wsize;
+    Elf32_Addr heap;
+    unsigned n, i, page_size;
+    bool ok;
+    struct timeval t0, t1;
+
+    if (f == NULL)
+      return false;
+    gettimeofday(&t0, NULL);
+
+    ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, PRELINK_MAGIC, 8) &&
+      get(f, key) && key == cache_key && get(f, wsize) && wsize == word_size &&
+      get(f, heap) && heap <= mem_size &&
+      get(f, n);
+
+    /* Every library must still have the same contents */
+    for (i = 0; ok && i < n; i++) {
+      unsigned len;
+      ok = get(f, len) && len < 4096;
+      if (!ok)
+        break;
+      std::string soname(len, '\0');
+      ok = fread(&soname[0], 1, len, f) == len && get(f, key) &&
+        hash_library(soname.c_str(), &h) && h == key;
+    }
+
+    std::vector<unsigned> initvec, finivec;
+    std::vector<Elf32_Addr> regions;
+    Elf32_Addr new_entry = 0;
+    if (ok) {
+      ok = get(f, new_entry) && get(f, n);
+      for (i = 0; ok && i < n; i++) {
+        unsigned v;
+        ok = get(f, v);
+        initvec.push_back(v);
+      }
+      ok = ok && get(f, n);
+      for (i = 0; ok && i < n; i++) {
+        unsigned v;
+        ok = get(f, v);
+        finivec.push_back(v);
+      }
+      ok = ok && get(f, n);
+      for (i = 0; ok && i < n; i++) {
+        Elf32_Addr start, end;
+        int prot;
+        ok = get(f, start) && get(f, end) && get(f, prot) && start < end && end <= mem_size;
+        regions.push_back(start);
+        regions.push_back(end);
+        regions.push_back(prot);
+      }
+      ok = ok && get(f, page_size) && page_size == PRELINK_PAGE && get(f, n);
+    }
+
+    /* From here on the memory is modified: a truncated file is fatal */
+    if (ok) {
+      std::vector<unsigned char> present(image_pages(heap, mem_size), 0);
+      for (i = 0; i < n; i++) {
+        Elf32_Addr addr;
+        if (!get(f, addr) || addr % PRELINK_PAGE || addr + PRELINK_PAGE > mem_size ||
+            fread(mem + addr, 1, PRELINK_PAGE, f) != PRELINK_PAGE) {
+          AC_ERROR("Run-time dynamic linker: corrupted cache file \"" << path << "\".");
+          exit(EXIT_FAILURE);
+        }
+        if (addr / PRELINK_PAGE < present.size())
+          present[addr / PRELINK_PAGE] = 1;
+      }
+      /* Pages left out were all zeros after linking */
+      for (i = 0; i < present.size(); i++)
+        if (!present[i] && !page_is_zero(mem + i * PRELINK_PAGE))
+          memset(mem + i * PRELINK_PAGE, 0, PRELINK_PAGE);
+    }
+    fclose(f);
+    if (!ok)
+      return false;
+
+    for (i = 0; i < regions.size(); i += 3)
+      mem_map.add_region(regions[i], regions[i + 1] - regions[i], regions[i + 2]);
+    ac_heap_ptr = heap;
+    mem_map.set_brk_addr(ac_heap_ptr);
+    start_addr = new_entry;
+    cached_initvec.swap(initvec);
+    cached_finivec.swap(finivec);
+
+    gettimeofday(&t1, NULL);
+    AC_SAY("Dynamic linking cache hit: " << path << " ("
+           << (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6 << " s)");
+    return true;
+  }
+
+  void ac_rtld::store_cache(unsigned char *mem, Elf32_Word mem_size, Elf32_Addr start_addr,
+                            unsigned int ac_heap_ptr) {
+    std::string path = cache_path(cache_key);
+    char tmp_suffix[32];
+    link_node *p;
+    unsigned n, i;
+
+    /* Written to a private name and renamed, as concurrent runs of the
+       same application may share the directory */
+    snprintf(tmp_suffix, sizeof(tmp_suffix), ".%ld.tmp", (long) getpid());
+    std::string tmp = path + tmp_suffix;
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) {
+      AC_WARN("Run-time dynamic linker: could not write cache file \"" << tmp << "\".");
+      return;
+    }
+
+    fwrite(PRELINK_MAGIC, 8, 1, f);
+    put(f, cache_key);
+    put(f, word_size);
+    put(f, (Elf32_Addr) ac_heap_ptr);
+
+    for (n = 0, p = root->get_next(); p != NULL; p = p->get_next())
+      n++;
+    put(f, n);
+    for (p = root->get_next(); p != NULL; p = p->get_next()) {
+      const char *soname = (const char *) p->get_soname();
+      unsigned len = strlen(soname);
+      unsigned long long h = 0;
+      if (!hash_library(soname, &h)) {
+        fclose(f);
+        unlink(tmp.c_str());
+        return;
+      }
+      put(f, len);
+      fwrite(soname, 1, len, f);
+      put(f, h);
+    }
+
+    put(f, start_addr);
+    n = get_init_arraysz();
+    put(f, n);
+    for (i = 0; i < n; i++)
+      put(f, get_init_array()[i]);
+    n = get_fini_arraysz();
+    put(f, n);
+    for (i = 0; i < n; i++)
+      put(f, get_fini_array()[i]);
+
+    const memmap::region_map& regions = mem_map.get_regions();
+    put(f, (unsigned) regions.size());
+    for (memmap::region_map::const_iterator it = regions.begin(); it != regions.end(); ++it) {
+      put(f, it->first);
+      put(f, it->second.end);
+      put(f, it->second.prot);
+    }
+
+    /* Only the pages that are not all zeros */
+    unsigned pages = image_pages(ac_heap_ptr, mem_size);
+    put(f, (unsigned) PRELINK_PAGE);
+    for (n = 0, i = 0; i < pages; i++)
+      if (!page_is_zero(mem + i * PRELINK_PAGE))
+        n++;
+    put(f, n);
+    for (i = 0; i < pages; i++)
+      if (!page_is_zero(mem + i * PRELINK_PAGE)) {
+        Elf32_Addr addr = i * PRELINK_PAGE;
+        put(f, addr);
+        fwrite(mem + addr, 1, PRELINK_PAGE, f);
+      }
+
+    if (fclose(f) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+      AC_WARN("Run-time dynamic linker: could not write cache file \"" << path << "\".");
+      unlink(tmp.c_str());
+    }
+  }
+
+}
@@ -0,0 +1,410 @@
+/**
+ * @file      ac_profiler.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Guest code profiler for generated simulators.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+
+//Fix for Cygwin users, that do not have elf.h
+#if defined(__CYGWIN__) || defined(__APPLE__)
+#include "elf32-tiny.h"
+#else
+#include <elf.h>
+#endif /* __CYGWIN__ */
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_profiler.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// using statements
+using std::ofstream;
+using std::setw;
+using std::map;
+using std::pair;
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// Initial number of slots of the block and arc tables (power of two).
+static const size_t AC_PROF_INITIAL_SLOTS = 4096;
+
+/// Number of hot blocks listed in the report.
+static const size_t AC_PROF_HOT_BLOCKS = 30;
+
+static inline size_t hash_pc(unsigned pc) {
+  return (size_t) ((pc >> 1) * 2654435761U);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Constructors
+
+/// Default constructor.
+ac_profiler::ac_profiler() :
+  enabled(false), nblocks(0), narcs(0), in_block(false),
+  cur_leader(0), next_pc(0), cur_instrs(0), cur_cycles(0), dump_pending(0) {}
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Methods
+
+/// Starts profiling the given program, writing reports to file.
+bool ac_profiler::enable(const char* prog, const char* file) {
+  block_entry be = { 0, false, 0, 0, 0 };
+  arc_entry ae = { 0, 0, false, 0 };
+
+  blocks.assign(AC_PROF_INITIAL_SLOTS, be);
+  arcs.assign(AC_PROF_INITIAL_SLOTS, ae);
+  program = prog ? prog : "";
+  output = file;
+
+  if (prog && !load_symbols(prog))
+    fprintf(stderr, "ArchC Warning: profiler could not read symbols from '%s'.\n", prog);
+
+  enabled = true;
+  return true;
+}
+
+ac_profiler::block_entry& ac_profiler::find_block(unsigned leader) {
+  size_t mask = blocks.size() - 1;
+  size_t i = hash_pc(leader) & mask;
+
+  while (blocks[i].used && blocks[i].leader != leader)
+    i = (i + 1) & mask;
+
+  if (!blocks[i].used) {
+    if (2 * (nblocks + 1) > blocks.size()) {
+      grow_blocks();
+      return find_block(leader);
+    }
+    blocks[i].used = true;
+    blocks[i].leader = leader;
+    nblocks++;
+  }
+  return blocks[i];
+}
+
+ac_profiler::arc_entry& ac_profiler::find_arc(unsigned from, unsigned to) {
+  size_t mask = arcs.size() - 1;
+  size_t i = (hash_pc(from) ^ (hash_pc(to) >> 7)) & mask;
+
+  while (arcs[i].used && (arcs[i].from != from || arcs[i].to != to))
+    i = (i + 1) & mask;
+
+  if (!arcs[i].used) {
+    if (2 * (narcs + 1) > arcs.size()) {
+      grow_arcs();
+      return find_arc(from, to);
+    }
+    arcs[i].used = true;
+    arcs[i].from = from;
+    arcs[i].to = to;
+    narcs++;
+  }
+  return arcs[i];
+}
+
+void ac_profiler::grow_blocks() {
+  vector<block_entry> old;
+  block_entry be = { 0, false, 0, 0, 0 };
+
+  old.swap(blocks);
+  blocks.assign(old.size() * 2, be);
+  nblocks = 0;
+  for (size_t i = 0; i < old.size(); i++)
+    if (old[i].used)
+      find_block(old[i].leader) = old[i];
+}
+
+void ac_profiler::grow_arcs() {
+  vector<arc_entry> old;
+  arc_entry ae = { 0, 0, false, 0 };
+
+  old.swap(arcs);
+  arcs.assign(old.size() * 2, ae);
+  narcs = 0;
+  for (size_t i = 0; i < old.size(); i++)
+    if (old[i].used)
+      find_arc(old[i].from, old[i].to) = old[i];
+}
+
+/// Closes the running block and opens a new one at pc.
+void ac_profiler::new_block(unsigned pc) {
+  if (in_block) {
+    block_entry& b = find_block(cur_leader);
+    b.instrs += cur_instrs;
+    b.cycles += cur_cycles;
+    find_arc(cur_leader, pc).count++;
+  }
+
+  find_block(pc).execs++;
+  in_block = true;
+  cur_leader = pc;
+  cur_instrs = 0;
+  cur_cycles = 0;
+}
+
+static inline bool host_is_big_endian() {
+  unsigned one = 1;
+  return *((unsigned char*) &one) == 0;
+}
+
+static inline unsigned get32(unsigned v, bool swap) {
+  return swap ? ((v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24)) : v;
+}
+
+static inline unsigned get16(unsigned short v, bool swap) {
+  return swap ? (unsigned short) ((v >> 8) | (v << 8)) : v;
+}
+
+static bool symbol_less(const ac_profiler::symbol& a, const ac_profiler::symbol& b) {
+  return a.addr < b.addr;
+}
+
+/// Reads the function symbols of an ELF file.
+bool ac_profiler::load_symbols(const char* filename) {
+  Elf32_Ehdr ehdr;
+  Elf32_Shdr shdr, strhdr;
+  FILE* fd;
+  bool swap;
+
+  if (!(fd = fopen(filename, "rb")))
+    return false;
+
+  if (fread(&ehdr, sizeof(ehdr), 1, fd) != 1 ||
+      strncmp((char*) ehdr.e_ident, ELFMAG, 4) != 0) {
+    fclose(fd);
+    return false;
+  }
+
+  swap = (ehdr.e_ident[EI_DATA] == ELFDATA2MSB) != host_is_big_endian();
+
+  unsigned shoff = get32(ehdr.e_shoff, swap);
+  unsigned shentsize = get16(ehdr.e_shentsize, swap);
+  unsigned shnum = get16(ehdr.e_shnum, swap);
+
+  for (unsigned i = 0; i < shnum; i++) {
+    fseek(fd, shoff + i * shentsize, SEEK_SET);
+    if (fread(&shdr, sizeof(shdr), 1, fd) != 1)
+      break;
+    if (get32(shdr.sh_type, swap) != SHT_SYMTAB)
+      continue;
+
+    // The associated string table.
+    fseek(fd, shoff + get32(shdr.sh_link, swap) * shentsize, SEEK_SET);
+    if (fread(&strhdr, sizeof(strhdr), 1, fd) != 1)
+      break;
+
+    vector<char> strtab(get32(strhdr.sh_size, swap) + 1, 0);
+    fseek(fd, get32(strhdr.sh_offset, swap), SEEK_SET);
+    if (fread(&strtab[0], 1, strtab.size() - 1, fd) != strtab.size() - 1)
+      break;
+
+    unsigned nsyms = get32(shdr.sh_size, swap) / sizeof(Elf32_Sym);
+    fseek(fd, get32(shdr.sh_offset, swap), SEEK_SET);
+    for (unsigned j = 0; j < nsyms; j++) {
+      Elf32_Sym sym;
+      if (fread(&sym, sizeof(sym), 1, fd) != 1)
+        break;
+      if (ELF32_ST_TYPE(sym.st_info) != STT_FUNC || get16(sym.st_shndx, swap) == SHN_UNDEF)
+        continue;
+      unsigned name = get32(sym.st_name, swap);
+      if (name >= strtab.size())
+        continue;
+      symbol s;
+      s.addr = get32(sym.st_value, swap);
+      s.size = get32(sym.st_size, swap);
+      s.name = &strtab[name];
+      symbols.push_back(s);
+    }
+  }
+  fclose(fd);
+
+  std::sort(symbols.begin(), symbols.end(), symbol_less);
+
+  // Symbols without size extend up to the next one.
+  for (size_t i = 0; i < symbols.size(); i++)
+    if (!symbols[i].size && i + 1 < symbols.size())
+      symbols[i].size = symbols[i + 1].addr - symbols[i].addr;
+
+  return !symbols.empty();
+}
+
+/// Index of the function containing addr, or -1.
+int ac_profiler::lookup(unsigned addr) const {
+  int lo = 0, hi = (int) symbols.size() - 1, found = -1;
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (symbols[mid].addr <= addr) {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+
+  if (found >= 0 && symbols[found].size && addr - symbols[found].addr >= symbols[found].size)
+    return -1;
+  return found;
+}
+
+/// Prints addr as function+offset.
+string ac_profiler::symbolize(unsigned addr) const {
+  char buf[32];
+  int i = lookup(addr);
+
+  if (i < 0) {
+    sprintf(buf, "0x%08x", addr);
+    return buf;
+  }
+  if (addr == symbols[i].addr)
+    return symbols[i].name;
+  sprintf(buf, "+0x%x", addr - symbols[i].addr);
+  return symbols[i].name + buf;
+}
+
+static bool hotter(const ac_profiler::block_entry* a, const ac_profiler::block_entry* b) {
+  return a->cycles > b->cycles;
+}
+
+/// Aggregated statistics of a guest function.
+struct ac_prof_func {
+  unsigned long long cycles, instrs, calls;
+  ac_prof_func() : cycles(0), instrs(0), calls(0) {}
+};
+
+typedef pair<unsigned long long, string> ac_prof_rank;
+
+static bool rank_greater(const ac_prof_rank& a, const ac_prof_rank& b) {
+  return a.first > b.first;
+}
+
+/// Writes the reports to a stream.
+void ac_profiler::dump(ostream& os) {
+  map<string, ac_prof_func> funcs;
+  map<pair<string, string>, unsigned long long> calls;
+  vector<const block_entry*> hot;
+  unsigned long long total_cycles = 0, total_instrs = 0;
+
+  // Account the running block without closing it.
+  if (in_block) {
+    block_entry& b = find_block(cur_leader);
+    b.instrs += cur_instrs;
+    b.cycles += cur_cycles;
+    cur_instrs = 0;
+    cur_cycles = 0;
+  }
+
+  for (size_t i = 0; i < blocks.size(); i++) {
+    if (!blocks[i].used)
+      continue;
+    int f = lookup(blocks[i].leader);
+    ac_prof_func& pf = funcs[f < 0 ? string("<unknown>") : symbols[f].name];
+    pf.cycles += blocks[i].cycles;
+    pf.instrs += blocks[i].instrs;
+    total_cycles += blocks[i].cycles;
+    total_instrs += blocks[i].instrs;
+    hot.push_back(&blocks[i]);
+  }
+
+  // A transition to the entry of another function is counted as a call.
+  for (size_t i = 0; i < arcs.size(); i++) {
+    if (!arcs[i].used)
+      continue;
+    int to = lookup(arcs[i].to);
+    if (to < 0 || symbols[to].addr != arcs[i].to)
+      continue;
+    int from = lookup(arcs[i].from);
+    if (from == to)
+      continue;
+    string caller = from < 0 ? string("<unknown>") : symbols[from].name;
+    calls[make_pair(caller, symbols[to].name)] += arcs[i].count;
+    funcs[symbols[to].name].calls += arcs[i].count;
+  }
+
+  os << "ArchC guest profile for " << program << "\n";
+  os << "    Instructions: " << total_instrs << "\n";
+  os << "    Estimated cycles: " << total_cycles << "\n\n";
+
+  // Flat profile.
+  vector<ac_prof_rank> ranking;
+  for (map<string, ac_prof_func>::iterator it = funcs.begin(); it != funcs.end(); it++)
+    ranking.push_back(ac_prof_rank(it->second.cycles, it->first));
+  std::stable_sort(ranking.begin(), ranking.end(), rank_greater);
+
+  os << "Flat profile:\n\n";
+  os << "  %cycles        cycles        instrs         calls  function\n";
+  for (size_t i = 0; i < ranking.size(); i++) {
+    ac_prof_func& pf = funcs[ranking[i].second];
+    char pct[16];
+    sprintf(pct, "%7.2f", total_cycles ? 100.0 * pf.cycles / total_cycles : 0.0);
+    os << "  " << pct << " " << setw(13) << pf.cycles << " " << setw(13) << pf.instrs
+       << " " << setw(13) << pf.calls << "  " << ranking[i].second << "\n";
+  }
+
+  // Call graph.
+  os << "\nCall graph:\n\n";
+  os << "          calls  caller -> callee\n";
+  for (map<pair<string, string>, unsigned long long>::iterator it = calls.begin();
+       it != calls.end(); it++)
+    os << "  " << setw(13) << it->second << "  " << it->first.first << " -> " << it->first.second << "\n";
+
+  // Hot blocks.
+  std::sort(hot.begin(), hot.end(), hotter);
+  os << "\nHot blocks:\n\n";
+  os << "      leader        execs        instrs        cycles  location\n";
+  for (size_t i = 0; i < hot.size() && i < AC_PROF_HOT_BLOCKS; i++) {
+    char leader[16];
+    sprintf(leader, "0x%08x", hot[i]->leader);
+    os << "  " << leader << " " << setw(12) << hot[i]->execs << " " << setw(13) << hot[i]->instrs
+       << " " << setw(13) << hot[i]->cycles << "  " << symbolize(hot[i]->leader) << "\n";
+  }
+  os << std::endl;
+}
+
+/// Writes the reports to the profile file, or defers it to the next
+/// instruction when called from the SIGUSR1 handler.
+void ac_profiler::dump() {
+  if (!enabled)
+    return;
+
+  if (ac_profile_defer) {
+    dump_pending = 1;
+    return;
+  }
+
+  ofstream file(output.c_str());
+  if (!file) {
+    fprintf(stderr, "ArchC Warning: could not write profile file '%s': %s\n",
+            output.c_str(), strerror(errno));
+    return;
+  }
+  dump(file);
+  fprintf(stderr, "ArchC: Guest profile written to %s\n", output.c_str());
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,165 @@
+/**
+ * @file      ac_sampler.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Sampled simulation control for generated simulators.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <stdio.h>
+#include <math.h>
+#include <iomanip>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_sampler.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// using statements
+using std::endl;
+using std::setw;
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// Normal quantile of the reported confidence intervals (95%).
+#define AC_SAMPLE_Z 1.96
+
+ac_sampler::ac_sampler() :
+  enabled(false), started(false), current(FUNCTIONAL), period(0), warmup(0),
+  window(0), next(0), period_start(0), window_start(0), windows(0),
+  detailed_instrs(0), cycles(0) {}
+
+bool ac_sampler::enable(const char *spec) {
+  if (sscanf(spec, "%llu,%llu,%llu", &period, &warmup, &window) != 3 ||
+      !window || warmup + window > period) {
+    fprintf(stderr, "ArchC: Invalid sampling parameters '%s': expected "
+            "<period>,<warmup>,<window> with warmup + window <= period and "
+            "window > 0.\n", spec);
+    return enabled = false;
+  }
+  return enabled = true;
+}
+
+void ac_sampler::add_metric(const char *name) {
+  metric m;
+
+  m.name = name;
+  m.start = m.sum = m.sum_sq = 0;
+  metrics.push_back(m);
+}
+
+ac_sampler::mode ac_sampler::advance(unsigned long long instr_count) {
+  if (!started) {
+    started = true;
+    current = FUNCTIONAL;
+    period_start = instr_count;
+    next = period_start + period - warmup - window;
+  }
+  else
+    step();
+
+  // Modes of zero length are skipped. Windows are never empty.
+  while (next == instr_count)
+    step();
+  return current;
+}
+
+void ac_sampler::step() {
+  switch (current) {
+  case FUNCTIONAL:
+    current = WARMUP;
+    next = period_start + period - window;
+    break;
+  case WARMUP:
+    current = DETAILED;
+    next = period_start + period;
+    break;
+  case DETAILED:
+    current = FUNCTIONAL;
+    period_start += period;
+    next = period_start + period - warmup - window;
+    break;
+  }
+}
+
+void ac_sampler::window_begin(unsigned long long instr_count, const double *values) {
+  window_start = instr_count;
+  for (unsigned i = 0; i < metrics.size(); i++)
+    metrics[i].start = values[i];
+}
+
+void ac_sampler::window_end(unsigned long long instr_count, const double *values) {
+  unsigned long long n = instr_count - window_start;
+
+  if (!n)
+    return;
+  for (unsigned i = 0; i < metrics.size(); i++) {
+    double rate = (values[i] - metrics[i].start) / n;
+    metrics[i].sum += rate;
+    metrics[i].sum_sq += rate * rate;
+  }
+  windows++;
+  detailed_instrs += n;
+}
+
+void ac_sampler::dump(unsigned long long total_instrs, ostream &out) const {
+  unsigned long long needed = 0;
+
+  out << "\nArchC: Sampled simulation: " << windows << " windows of " << window
+      << " instructions, " << warmup << " warmup, period " << period << endl;
+  out << "ArchC: " << detailed_instrs << " of " << total_instrs
+      << " instructions measured in detail";
+  if (total_instrs)
+    out << " (" << 100.0 * detailed_instrs / total_instrs << "%)";
+  out << endl;
+
+  if (!windows) {
+    out << "ArchC: No measurement window was completed." << endl;
+    return;
+  }
+
+  out << "ArchC: " << setw(24) << std::left << "metric" << std::right
+      << setw(14) << "per instr" << setw(14) << "+/- 95%"
+      << setw(18) << "estimated total" << setw(16) << "+/- 95%" << endl;
+
+  for (unsigned i = 0; i < metrics.size(); i++) {
+    const metric &m = metrics[i];
+    double mean = m.sum / windows;
+    double var = windows > 1 ? (m.sum_sq - windows * mean * mean) / (windows - 1) : 0;
+    double half = var > 0 ? AC_SAMPLE_Z * sqrt(var / windows) : 0;
+
+    out << "ArchC: " << setw(24) << std::left << m.name << std::right
+        << setw(14) << mean << setw(14) << half
+        << setw(18) << (unsigned long long) (mean * total_instrs + 0.5)
+        << setw(16) << (unsigned long long) (half * total_instrs + 0.5) << endl;
+
+    // Windows needed for +/-3% at 99.7% confidence, as suggested by SMARTS.
+    if (mean > 0 && var > 0) {
+      double cv = sqrt(var) / mean;
+      unsigned long long n = (unsigned long long) ceil((3 * cv / 0.03) * (3 * cv / 0.03));
+      if (n > needed)
+        needed = n;
+    }
+  }
+
+  if (windows < 2)
+    out << "ArchC: At least two windows are needed for confidence intervals." << endl;
+  else if (needed > windows)
+    out << "ArchC: " << needed << " windows are needed for +/-3% at 99.7% confidence." << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,131 @@
+/**
+ * @file      ac_memport_bench.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Microbenchmark of the ac_memport load and store paths.
+ *
+ *            Times byte, half word and word loads and stores through a
+ *            memport on an ac_storage, for a target of the host byte order
+ *            and for one of the opposite order. Built with
+ *            "make ac_memport_bench" in src/aclib.
+ *
+ *            Usage: ac_memport_bench [accesses]
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_memport.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_MEM_SIZE (1 << 20)
+
+typedef uint32_t bench_word;
+typedef uint16_t bench_Hword;
+
+/// Minimal architecture owning the memport.
+class bench_arch : public ac_arch<bench_word, bench_Hword> {
+public:
+  bench_arch() : ac_arch<bench_word, bench_Hword>(4) {}
+  void init() {}
+  void init(int ac, char *av[]) {}
+  void stop(int status) {}
+  void load(char* program) {}
+  void delayed_load(char* program) {}
+  unsigned get_ac_pc() { return 0; }
+#ifdef USE_GDB
+  AC_GDB<bench_word>* get_gdbstub() { return 0; }
+#endif
+};
+
+// Needed by the library, never called.
+const char *project_name = "ac_memport_bench";
+const char *project_file = "";
+const char *archc_version = "";
+const char *archc_options = "";
+
+static double now() {
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char* what, bool match, unsigned long n, double t) {
+  printf("%-12s %-8s %8.2f ns/access\n", what, match ? "native" : "swapped", t * 1e9 / n);
+}
+
+// The address sequence walks the memory with a stride, so that the loop
+// cannot be reduced to a single access.
+#define BENCH_ADDR(i, size) (((i) * 4099 * (size)) & (BENCH_MEM_SIZE - 1) & ~((size) - 1))
+
+static unsigned long long run(ac_memport<bench_word, bench_Hword>& port, bool match, unsigned long n) {
+  unsigned long long sum = 0;
+  double t;
+
+  t = now();
+  for (unsigned long i = 0; i < n; i++)
+    port.write_byte(BENCH_ADDR(i, 1), (uint8_t) i);
+  report("store byte", match, n, now() - t);
+
+  t = now();
+  for (unsigned long i = 0; i < n; i++)
+    port.write_half(BENCH_ADDR(i, 2), (bench_Hword) i);
+  report("store half", match, n, now() - t);
+
+  t = now();
+  for (unsigned long i = 0; i < n; i++)
+    port.write(BENCH_ADDR(i, 4), (bench_word) i);
+  report("store word", match, n, now() - t);
+
+  t = now();
+  for (unsigned long i = 0; i < n; i++)
+    sum += port.read_byte(BENCH_ADDR(i, 1));
+  report("load byte", match, n, now() - t);
+
+  t = now();
+  for (unsigned long i = 0; i < n; i++)
+    sum += port.read_half(BENCH_ADDR(i, 2));
+  report("load half", match, n, now() - t);
+
+  t = now();
+  for (unsigned long i = 0; i < n; i++)
+    sum += port.read(BENCH_ADDR(i, 4));
+  report("load word", match, n, now() - t);
+
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long n = (argc > 1) ? strtoul(argv[1], NULL, 0) : 50000000;
+  bench_arch arch;
+  ac_storage mem("mem", BENCH_MEM_SIZE);
+  ac_memport<bench_word, bench_Hword> port(arch, mem);
+  unsigned long long sum = 0;
+
+  for (int match = 1; match >= 0; match--) {
+    arch.ac_mt_endian = match;
+    sum += run(port, match, n);
+  }
+
+  // Keeps the loads alive.
+  return sum == 1;
+}
@@ -16,18 +16,42 @@
  *
  */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <map>
+
 #include "ac_storage.H"
 
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
 // constructor
 ac_storage::ac_storage(string nm, uint32_t sz) :
   name(nm),
-  size(sz) {
-  data.ptr8 = new unsigned char[sz];
+  size(sz),
+  file_backed(false) {
+  // Untouched pages read as zeros and take no host memory.
+  void* p = mmap(0, sz ? sz : 1, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if ((mapped = (p != MAP_FAILED)))
+    data.ptr8 = static_cast<unsigned char*>(p);
+  else
+    data.ptr8 = new unsigned char[sz]();
 }
 
 // destructor
 ac_storage::~ac_storage() {
-  delete[] data.ptr8;
+  if (mapped)
+    munmap(data.ptr8, size ? size : 1);
+  else
+    delete[] data.ptr8;
 }
 
 // getters and setters
@@ -43,28 +67,247 @@ uint32_t ac_storage::get_size() const {
   return size;
 }
 
-void ac_storage::read(ac_ptr buf, uint32_t address,
-		      int wordsize) {
+/// Marks in present, a byte per checkpoint page, the pages of the host
+/// mapping at data that the host has allocated or swapped out: the others
+/// read as zeros. Returns false if the host does not tell.
+static bool touched_pages(const uint8_t* data, uint32_t size, std::vector<unsigned char>& present) {
+#ifdef __linux__
+  int fd = open("/proc/self/pagemap", O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  uint32_t page = sysconf(_SC_PAGE_SIZE);
+  uint32_t pages = (size + page - 1) / page;
+  std::vector<uint64_t> entries(pages);
+  char* buf = (char*) &entries[0];
+  size_t left = pages * sizeof(uint64_t);
+  off_t offset = (uintptr_t) data / page * sizeof(uint64_t);
+  while (left > 0) {
+    ssize_t n = pread(fd, buf, left, offset);
+    if (n <= 0)
+      break;
+    buf += n;
+    offset += n;
+    left -= n;
+  }
+  close(fd);
+  if (left > 0)
+    return false;
+
+  for (uint32_t i = 0; i < pages; i++)
+    if (entries[i] & (3ULL << 62)) { // Present or swapped
+      uint32_t end = (size - i * page > page) ? (i + 1) * page : size;
+      for (uint32_t p = i * page / AC_CHECKPOINT_PAGE_SIZE;
+           p <= (end - 1) / AC_CHECKPOINT_PAGE_SIZE; p++)
+        present[p] = 1;
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ac_storage::save(ac_checkpoint& cp) const {
+  std::vector<unsigned char> present((size + AC_CHECKPOINT_PAGE_SIZE - 1) / AC_CHECKPOINT_PAGE_SIZE);
+
+  if (!mapped || present.empty() || !touched_pages(data.ptr8, size, present)) {
+    cp.put_memory(data.ptr8, size);
+    return;
+  }
+  // The pages of a file read as its contents even before they are touched
+  for (unsigned i = 0; i < file_pages.size(); i++)
+    for (uint32_t p = file_pages[i].first / AC_CHECKPOINT_PAGE_SIZE;
+         p * AC_CHECKPOINT_PAGE_SIZE < file_pages[i].second; p++)
+      present[p] = 1;
+  cp.put_memory(data.ptr8, size, &present[0]);
+}
 
+void ac_storage::restore(ac_checkpoint& cp) {
+  // The pages not in the checkpoint stay untouched
+  discard(0, size);
+  file_pages.clear();
+  cp.get_memory(data.ptr8, size, true);
+}
+
+void ac_storage::add_watcher(ac_write_watcher* w) {
+  watchers.push_back(w);
+}
+
+void ac_storage::remove_watcher(ac_write_watcher* w) {
+  for (unsigned i = 0; i < watchers.size(); i++)
+    if (watchers[i] == w) {
+      watchers.erase(watchers.begin() + i);
+      break;
+    }
+}
 
-printf("\nREAD ac_storage");
+void ac_storage::discard(uint32_t address, uint32_t length) {
+  if (address >= size)
+    return;
+  if (length > size - address)
+    length = size - address;
+
+  uint32_t begin = address, end = address + length;
+#ifdef __linux__
+  if (mapped) {
+    // Whole host pages are dropped, they are zero again when next touched.
+    // Dropped pages of a file would be read again: they are replaced.
+    uint32_t page = sysconf(_SC_PAGE_SIZE);
+    uint32_t first = (address + page - 1) / page * page;
+    uint32_t last = (address + length) / page * page;
+    if (first < last &&
+        (file_backed ?
+         mmap(data.ptr8 + first, last - first, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) != MAP_FAILED :
+         madvise(data.ptr8 + first, last - first, MADV_DONTNEED) == 0)) {
+      memset(data.ptr8 + address, 0, first - address);
+      begin = last;
+    }
+  }
+#endif
+  memset(data.ptr8 + begin, 0, end - begin);
+
+  if (!watchers.empty())
+    notify(address, length);
+}
 
+/// Reads length bytes of fd at offset into buf.
+static bool read_file(int fd, uint32_t offset, uint8_t* buf, uint32_t length) {
+  while (length > 0) {
+    ssize_t n = pread(fd, buf, length, offset);
+    if (n <= 0)
+      return false;
+    buf += n;
+    offset += n;
+    length -= n;
+  }
+  return true;
+}
 
+/// Sealed in-memory copies of file ranges, by file identity and range.
+/// The copies live as long as the process, so every storage loaded from
+/// the same unchanged file shares them.
+struct snapshot_key {
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  long mtime_nsec;
+  uint32_t offset;
+  uint32_t length;
+
+  bool operator<(const snapshot_key& o) const {
+    if (dev != o.dev) return dev < o.dev;
+    if (ino != o.ino) return ino < o.ino;
+    if (size != o.size) return size < o.size;
+    if (mtime != o.mtime) return mtime < o.mtime;
+    if (mtime_nsec != o.mtime_nsec) return mtime_nsec < o.mtime_nsec;
+    if (offset != o.offset) return offset < o.offset;
+    return length < o.length;
+  }
+};
+
+/// Returns a file holding a copy of length bytes of fd from offset on,
+/// that can no longer be written, or -1 if the host cannot make one.
+/// Mapping the file itself would let a rewrite of the program on disk
+/// change the storage, and a truncation fault it.
+static int file_snapshot(int fd, uint32_t offset, uint32_t length) {
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+  static std::map<snapshot_key, int> snapshots;
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (off_t) offset + length > st.st_size)
+    return -1;
+
+  snapshot_key key = { st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec,
+                       st.st_mtim.tv_nsec, offset, length };
+  std::map<snapshot_key, int>::iterator i = snapshots.find(key);
+  if (i != snapshots.end())
+    return i->second;
+
+  int snap = memfd_create("ac_storage", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (snap < 0)
+    return -1;
+  void* p = MAP_FAILED;
+  bool ok = (ftruncate(snap, length) == 0) &&
+            ((p = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, snap, 0)) != MAP_FAILED);
+  ok = ok && read_file(fd, offset, static_cast<uint8_t*>(p), length);
+  if (p != MAP_FAILED)
+    munmap(p, length);
+  if (!ok || fcntl(snap, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    close(snap);
+    return -1;
+  }
+  snapshots[key] = snap;
+  return snap;
+#else
+  return -1;
+#endif
+}
+
+bool ac_storage::load_file(uint32_t address, int fd, uint32_t offset, uint32_t length) {
+  bool ok = false, shared = false;
+
+  if (mapped && length > 0) {
+    // Only the pages at the same place in the file and in the storage,
+    // and whole, can be mapped: the others are shared with other contents.
+    // They are mapped from a sealed copy of the file, never from the file.
+    uint32_t page = sysconf(_SC_PAGE_SIZE);
+    uint32_t first = (address + page - 1) / page * page;
+    uint32_t last = (address + length) / page * page;
+    int snap;
+    if ((address % page == offset % page) && first < last &&
+        (snap = file_snapshot(fd, offset + (first - address), last - first)) >= 0 &&
+        mmap(data.ptr8 + first, last - first, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, snap, 0) != MAP_FAILED) {
+      file_backed = shared = true;
+      file_pages.push_back(std::make_pair(first, last));
+      ok = read_file(fd, offset, data.ptr8 + address, first - address) &&
+           read_file(fd, offset + (last - address), data.ptr8 + last, address + length - last);
+    }
+  }
+  if (!shared)
+    ok = read_file(fd, offset, data.ptr8 + address, length);
+
+  if (!watchers.empty() && length > 0)
+    notify(address, length);
+  return ok;
+}
+
+void ac_storage::copy(uint32_t dst, uint32_t src, uint32_t length) {
+  memmove(data.ptr8 + dst, data.ptr8 + src, length);
+  if (!watchers.empty() && length > 0)
+    notify(dst, length);
+}
+
+void ac_storage::fill(uint32_t address, uint8_t value, uint32_t length) {
+  memset(data.ptr8 + address, value, length);
+  if (!watchers.empty() && length > 0)
+    notify(address, length);
+}
+
+void ac_storage::notify(uint32_t address, uint32_t length) {
+  for (unsigned i = 0; i < watchers.size(); i++)
+    watchers[i]->written(address, length);
+}
+
+void ac_storage::read(ac_ptr buf, uint32_t address,
+		      int wordsize) {
   switch (wordsize) {
   case 8: { // unsigned char
-    *(buf.ptr8) = (data.ptr8)[address];
+    *(buf.ptr8) = load<uint8_t>(address);
     break;
   }
   case 16: { // unsigned short
-    *(buf.ptr16) = *((uint16_t*) (data.ptr8 + address));
+    *(buf.ptr16) = load<uint16_t>(address);
     break;
   }
   case 32: { // unsigned int
-    *(buf.ptr32) = *((uint32_t*) (data.ptr8 + address));
+    *(buf.ptr32) = load<uint32_t>(address);
     break;
   }
   case 64: { // unsigned long long
-    *(buf.ptr64) = *((uint64_t*) (data.ptr8 + address));
+    *(buf.ptr64) = load<uint64_t>(address);
     break;
   }
   default: // weird size
@@ -74,9 +317,6 @@ printf("\nREAD ac_storage");
 
 void ac_storage::read(ac_ptr buf, uint32_t address,
 		      int wordsize, int n_words) {
-
-printf("\nREAD n_words ac_storage");
-
   switch (wordsize) {
   case 8: { // unsigned char
     for (int i = 0; i < n_words; i++)
@@ -107,19 +347,19 @@ void ac_storage::write(ac_ptr buf, uint32_t address,
 		       int wordsize) {
   switch (wordsize) {
   case 8: { // unsigned char
-    (data.ptr8)[address] = *(buf.ptr8);
+    store<uint8_t>(address, *(buf.ptr8));
     break;
   }
   case 16: { // unsigned short
-    *((uint16_t*) (data.ptr8 + address)) = *(buf.ptr16);
+    store<uint16_t>(address, *(buf.ptr16));
     break;
   }
   case 32: { // unsigned int
-    *((uint32_t*) (data.ptr8 + address)) = *(buf.ptr32);
+    store<uint32_t>(address, *(buf.ptr32));
     break;
   }
   case 64: { // unsigned long long
-    *((uint64_t*) (data.ptr8 + address)) = *(buf.ptr64);
+    store<uint64_t>(address, *(buf.ptr64));
     break;
   }
   default: // weird size
@@ -151,8 +391,10 @@ void ac_storage::write(ac_ptr buf, uint32_t address,
     break;
   }
   default: // weird size
-    break;
+    return;
   }
+  if (!watchers.empty() && n_words > 0)
+    notify(address & ~(wordsize / 8 - 1), n_words * (wordsize / 8));
 }
 
 
@@ -21,6 +21,8 @@
 
 
 // Standard includes
+#include <string.h>
+#include <algorithm>
 
 // SystemC includes
 
@@ -41,7 +43,7 @@
  * @param size Size or address range of the element to be attached.
  * 
  */
-ac_tlm2_nb_port::ac_tlm2_nb_port(char const* nm, uint32_t sz) : name(nm), size(sz), LOCAL_init_socket() {
+ac_tlm2_nb_port::ac_tlm2_nb_port(char const* nm, uint32_t sz) : payload_global(0), wb_used(0), posted_writes(false), name(nm), size(sz), LOCAL_init_socket() {
 
   LOCAL_init_socket.register_nb_transport_bw(this, &ac_tlm2_nb_port::nb_transport_bw);
 
@@ -54,6 +56,17 @@ tlm::tlm_sync_enum  ac_tlm2_nb_port::nb_transport_bw(ac_tlm2_payload &payload, t
 	#ifdef debugTLM2
 	printf("\n\nNB_TRANSPORT_BW --> Processor is receiving a package");
 	#endif
+
+	// Response to a posted write: nobody waits for its data
+	for (std::list<ac_tlm2_payload*>::iterator i = posted.begin(); i != posted.end(); i++)
+		if (*i == &payload) {
+			posted.erase(i);
+			delete [] payload.get_data_ptr();
+			delete &payload;
+			posted_done.notify();
+			phase = tlm::END_RESP;
+			return tlm::TLM_COMPLETED;
+		}
  	
 	unsigned char* data_pointer = payload.get_data_ptr();		 
 	uint32_t addr = (uint32_t) payload.get_address();
@@ -91,6 +104,14 @@ tlm::tlm_sync_enum  ac_tlm2_nb_port::nb_transport_bw(ac_tlm2_payload &payload, t
 void ac_tlm2_nb_port::read(ac_ptr buf, uint32_t address, int wordsize,sc_core::sc_time &time_info)
 {
 
+	// The write buffer goes out before the load, which then sees its stores
+	if (posted_writes) {
+		if (wb_forward(buf.ptr8, address, wordsize / 8))
+			return;
+		wb_post(wb_used);
+		wb_wait(address, wordsize / 8);
+	}
+
 	payload_global = new ac_tlm2_payload();
 
 	tlm::tlm_phase phase = tlm::BEGIN_REQ;
@@ -175,6 +196,11 @@ void ac_tlm2_nb_port::read(ac_ptr buf, uint32_t address, int wordsize,sc_core::s
 void ac_tlm2_nb_port::read(ac_ptr buf, uint32_t address,
                          int wordsize, int n_words,sc_core::sc_time &time_info) {
 
+	if (posted_writes) {
+		wb_post(wb_used);
+		wb_wait(address, n_words * (wordsize / 8));
+	}
+
 	payload_global = new ac_tlm2_payload();
 
 	tlm::tlm_phase phase = tlm::BEGIN_REQ;
@@ -291,6 +317,12 @@ void ac_tlm2_nb_port::read(ac_ptr buf, uint32_t address,
  */
 void ac_tlm2_nb_port::write(ac_ptr buf, uint32_t address, int wordsize,sc_core::sc_time &time_info) {
 
+  // Posted: the store waits in the write buffer, merged with its neighbors
+  if (posted_writes && ((wordsize == 8) || (wordsize == 16) || (wordsize == 32))) {
+    wb_store(buf.ptr8, address, wordsize / 8, time_info);
+    return;
+  }
+
   unsigned char p[32];
   unsigned int i;
   
@@ -428,8 +460,188 @@ void ac_tlm2_nb_port::write(ac_ptr buf, uint32_t address, int wordsize,sc_core::
 void ac_tlm2_nb_port::write(ac_ptr buf, uint32_t address,
                          int wordsize, int n_words,sc_core::sc_time &time_info) {
 
-  printf("ac_tlm2_nb_port write isn't implemented");
-  
+  if (posted_writes && ((wordsize == 8) || (wordsize == 16) || (wordsize == 32))) {
+    wb_store(buf.ptr8, address, n_words * (wordsize / 8), time_info);
+    return;
+  }
+
+  for (int i = 0; i < n_words; i++) {
+    ac_ptr word(buf.ptr8 + i * (wordsize / 8));
+    write(word, address + i * (wordsize / 8), wordsize, time_info);
+  }
+}
+
+/** 
+ * Puts a store in the write buffer. A store is merged into the youngest
+ * line if it does not overwrite a byte of it; otherwise the lines up to
+ * the one of the store leave first, so every store reaches the target,
+ * in program order.
+ * 
+ */
+void ac_tlm2_nb_port::wb_store(const unsigned char *bytes, uint32_t address, unsigned length,
+                               const sc_core::sc_time &time_info)
+{
+  while (length > 0) {
+    uint32_t base = address & ~(uint32_t) (AC_TLM2_WB_LINE_SIZE - 1);
+    unsigned offset = address - base;
+    unsigned n = std::min(length, AC_TLM2_WB_LINE_SIZE - offset);
+    uint32_t mask = ((n == 32) ? 0xffffffffu : ((1u << n) - 1)) << offset;
+    unsigned i;
+
+    for (i = 0; (i < wb_used) && (wb[i].base != base); i++)
+      ;
+    if ((i < wb_used) && ((i != wb_used - 1) || (wb[i].valid & mask))) {
+      wb_post(i + 1);
+      i = wb_used;
+    }
+    if (i == wb_used) {
+      if (wb_used == AC_TLM2_WB_LINES)
+        wb_post(1);
+      i = wb_used++;
+      wb[i].base = base;
+      wb[i].valid = 0;
+    }
+    memcpy(wb[i].data + offset, bytes, n);
+    wb[i].valid |= mask;
+    wb[i].delay = time_info;
+
+    bytes += n;
+    address += n;
+    length -= n;
+  }
+}
+
+/** 
+ * Copies a load from the write buffer, if all its bytes are there.
+ * 
+ */
+bool ac_tlm2_nb_port::wb_forward(unsigned char *bytes, uint32_t address, unsigned length)
+{
+  uint32_t base = address & ~(uint32_t) (AC_TLM2_WB_LINE_SIZE - 1);
+  unsigned offset = address - base;
+
+  if ((length == 0) || (offset + length > AC_TLM2_WB_LINE_SIZE))
+    return false;
+
+  uint32_t mask = ((length == 32) ? 0xffffffffu : ((1u << length) - 1)) << offset;
+
+  for (unsigned i = 0; i < wb_used; i++)
+    if (wb[i].base == base) {
+      if ((wb[i].valid & mask) != mask)
+        return false;
+      memcpy(bytes, wb[i].data + offset, length);
+      return true;
+    }
+  return false;
+}
+
+/** 
+ * Sends the n oldest lines to the target without waiting for the
+ * responses. Each run of adjacent bytes leaves as naturally aligned
+ * writes of 1, 2 or 4 bytes, the sizes a processor store could have.
+ * 
+ */
+void ac_tlm2_nb_port::wb_post(unsigned n)
+{
+  for (unsigned i = 0; i < n; i++) {
+    uint32_t valid = wb[i].valid;
+
+    for (unsigned b = 0; b < AC_TLM2_WB_LINE_SIZE; ) {
+      if (!(valid & (1u << b))) {
+        b++;
+        continue;
+      }
+
+      unsigned e = b;
+      while ((e < AC_TLM2_WB_LINE_SIZE) && (valid & (1u << e)))
+        e++;
+
+      while (b < e) {
+        uint32_t address = wb[i].base + b;
+        unsigned length = 1;
+
+        if (((address & 3) == 0) && (e - b >= 4))
+          length = 4;
+        else if (((address & 1) == 0) && (e - b >= 2))
+          length = 2;
+        wb_send(wb[i].data + b, address, length, wb[i].delay);
+        b += length;
+      }
+    }
+  }
+
+  std::copy(wb + n, wb + wb_used, wb);
+  wb_used -= n;
+}
+
+/** 
+ * Sends one posted write, carrying the time annotation of its store.
+ * 
+ */
+void ac_tlm2_nb_port::wb_send(const unsigned char *bytes, uint32_t address, unsigned length,
+                              const sc_core::sc_time &time_info)
+{
+  while (posted.size() >= AC_TLM2_WB_MAX_POSTED)
+    wait(posted_done);
+
+  ac_tlm2_payload *payload = new ac_tlm2_payload();
+  unsigned char *data = new unsigned char[length];
+  tlm::tlm_phase phase = tlm::BEGIN_REQ;
+  sc_core::sc_time delay = time_info;
+  tlm::tlm_sync_enum status;
+
+  memcpy(data, bytes, length);
+  payload->set_command(tlm::TLM_WRITE_COMMAND);
+  payload->set_address((uint64_t) address);
+  payload->set_data_ptr(data);
+  payload->set_data_length(length);
+  payload->set_streaming_width(length);
+
+  // Listed first: the response may come before nb_transport_fw returns
+  posted.push_back(payload);
+  status = LOCAL_init_socket->nb_transport_fw(*payload, phase, delay);
+  if (status == tlm::TLM_COMPLETED) {
+    std::list<ac_tlm2_payload*>::iterator p = std::find(posted.begin(), posted.end(), payload);
+    if (p != posted.end()) {
+      posted.erase(p);
+      delete [] data;
+      delete payload;
+    }
+  }
+  else if (status != tlm::TLM_UPDATED) {
+    printf("\nAC_TLM2_NB_PORT  WRITE ERROR");
+    exit(0);
+  }
+}
+
+/** 
+ * Waits for the posted writes overlapping a range.
+ * 
+ */
+void ac_tlm2_nb_port::wb_wait(uint32_t address, unsigned length)
+{
+  for (;;) {
+    bool overlap = false;
+
+    for (std::list<ac_tlm2_payload*>::iterator i = posted.begin(); i != posted.end(); i++)
+      if (((*i)->get_address() < (uint64_t) address + length) &&
+          (address < (*i)->get_address() + (*i)->get_data_length()))
+        overlap = true;
+    if (!overlap)
+      return;
+    wait(posted_done);
+  }
+}
+
+/** 
+ * Drains the write buffer and waits for the posted writes.
+ * 
+ */
+void ac_tlm2_nb_port::fence()
+{
+  wb_post(wb_used);
+  while (!posted.empty())
+    wait(posted_done);
 }
 
 
@@ -449,9 +661,8 @@ uint32_t ac_tlm2_nb_port::get_size() const {
  */
 void ac_tlm2_nb_port::lock()
 {
-	printf("\nAC_TLM2_NB_PORT::LOCK ERROR --> NOT IMPLEMENTED\n");  
-	exit(0);
-	
+	// TLM 2.0 has no bus lock: the locked accesses see the previous stores
+	fence();
 }
 
 /** 
@@ -460,9 +671,8 @@ void ac_tlm2_nb_port::lock()
  */
 void ac_tlm2_nb_port::unlock()
 {
-
-	printf("\nAC_TLM2_NB_PORT::UNLOCK ERROR --> NOT IMPLEMENTED\n");  
-	exit(0);
+	// The locked stores reach the target before the others go on
+	fence();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,364 @@
+/**
+ * @file      ac_tlm2_shm.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Distributed platforms: TLM 2.0 transactions between SystemC
+ *            processes of the same host, over shared memory.
+ *
+ * @attention Copyright (C) 2002-2009 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_tlm2_shm.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// States of a mailbox.
+enum {
+  MAILBOX_EMPTY,
+  MAILBOX_REQUEST,
+  MAILBOX_SERVING,
+  MAILBOX_RESPONSE
+};
+
+/// One transaction from a partition to another one. The times are in
+/// picoseconds: the time of the request at the initiator, then the time
+/// the target completed it.
+struct ac_tlm2_shm_mailbox {
+  uint32_t state;
+  uint32_t target;
+  uint32_t command;
+  uint32_t length;
+  int32_t response;
+  uint32_t unused;
+  uint64_t address;
+  uint64_t time;
+  unsigned char data[AC_SHM_MAX_DATA];
+};
+
+/// Shared memory of a domain, zero filled when created.
+struct ac_tlm2_shm_region {
+  uint32_t partitions;
+  int32_t pid[AC_SHM_MAX_PARTITIONS];
+  uint32_t done[AC_SHM_MAX_PARTITIONS];
+  uint64_t time[AC_SHM_MAX_PARTITIONS];                                   //!< Local time, in ps
+  ac_tlm2_shm_mailbox mailbox[AC_SHM_MAX_PARTITIONS][AC_SHM_MAX_PARTITIONS]; //!< [from][to]
+};
+
+static inline uint64_t to_ps(const sc_time& t) {
+  return (uint64_t) (t.to_seconds() * 1e12 + 0.5);
+}
+
+static inline sc_time from_ps(uint64_t ps) {
+  return sc_time((double) ps, SC_PS);
+}
+
+/// Spin, then give the processor away while waiting for another partition.
+static inline void relax(unsigned spins) {
+  if (spins > 64)
+    sched_yield();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+ac_tlm2_shm_domain::ac_tlm2_shm_domain(sc_module_name nm, const char *domain, unsigned id,
+                                       unsigned partitions, const sc_time& quantum,
+                                       bool passive) :
+  sc_module(nm), quantum(quantum), passive(passive), region(0), transactions(0) {
+  join(domain, id, partitions);
+  SC_THREAD(sync);
+}
+
+ac_tlm2_shm_domain::ac_tlm2_shm_domain(sc_module_name nm, const sc_time& quantum,
+                                       bool passive) :
+  sc_module(nm), quantum(quantum), passive(passive), region(0), transactions(0) {
+  const char *d = getenv("AC_SHM_DOMAIN");
+  const char *p = getenv("AC_SHM_PARTITION");
+  const char *n = getenv("AC_SHM_PARTITIONS");
+
+  if (!d || !p || !n) {
+    fprintf(stderr, "ArchC: AC_SHM_DOMAIN, AC_SHM_PARTITION and AC_SHM_PARTITIONS are not set: "
+            "run the partitions with ac_mpsoc.\n");
+    exit(EXIT_FAILURE);
+  }
+  join(d, strtoul(p, NULL, 0), strtoul(n, NULL, 0));
+  SC_THREAD(sync);
+}
+
+ac_tlm2_shm_domain::~ac_tlm2_shm_domain() {
+  if (region)
+    munmap(region, sizeof(ac_tlm2_shm_region));
+}
+
+void ac_tlm2_shm_domain::join(const char *domain_name, unsigned partition, unsigned n) {
+  struct stat st;
+  uint32_t expected = 0;
+  int fd;
+  void *p;
+
+  domain = std::string("/") + domain_name;
+  id = partition;
+  partitions = n;
+  if ((n == 0) || (n > AC_SHM_MAX_PARTITIONS) || (id >= n)) {
+    fprintf(stderr, "ArchC: Invalid partition %u of %u (at most %d partitions).\n",
+            id, n, AC_SHM_MAX_PARTITIONS);
+    exit(EXIT_FAILURE);
+  }
+
+  // The first partition to come creates the memory, all of them size it
+  if (((fd = shm_open(domain.c_str(), O_RDWR | O_CREAT, 0600)) < 0) || (fstat(fd, &st) < 0) ||
+      (((size_t) st.st_size < sizeof(ac_tlm2_shm_region)) &&
+       (ftruncate(fd, sizeof(ac_tlm2_shm_region)) < 0)) ||
+      ((p = mmap(0, sizeof(ac_tlm2_shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) ==
+       MAP_FAILED)) {
+    fprintf(stderr, "ArchC: Could not map the shared memory of domain '%s': %s\n",
+            domain_name, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+  region = (ac_tlm2_shm_region*) p;
+
+  if (!__atomic_compare_exchange_n(&region->partitions, &expected, n, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) && (expected != n)) {
+    fprintf(stderr, "ArchC: Domain '%s' has %u partitions, not %u.\n", domain_name, expected, n);
+    exit(EXIT_FAILURE);
+  }
+  __atomic_store_n(&region->pid[id], (int32_t) getpid(), __ATOMIC_RELEASE);
+}
+
+void ac_tlm2_shm_domain::add_export(unsigned target, ac_tlm2_shm_export *e) {
+  if (target >= exports.size())
+    exports.resize(target + 1, 0);
+  if (exports[target]) {
+    fprintf(stderr, "ArchC: Target %u of partition %u is exported twice.\n", target, id);
+    exit(EXIT_FAILURE);
+  }
+  exports[target] = e;
+}
+
+void ac_tlm2_shm_domain::check_alive(unsigned p) const {
+  pid_t pid = __atomic_load_n(&region->pid[p], __ATOMIC_ACQUIRE);
+
+  if (pid && !__atomic_load_n(&region->done[p], __ATOMIC_ACQUIRE) &&
+      (kill(pid, 0) < 0) && (errno == ESRCH)) {
+    fprintf(stderr, "ArchC: Partition %u of domain '%s' is gone.\n", p, domain.c_str() + 1);
+    exit(EXIT_FAILURE);
+  }
+}
+
+bool ac_tlm2_shm_domain::others_done() const {
+  for (unsigned p = 0; p < partitions; p++)
+    if ((p != id) && !__atomic_load_n(&region->done[p], __ATOMIC_ACQUIRE))
+      return false;
+  return true;
+}
+
+void ac_tlm2_shm_domain::serve() {
+  for (unsigned p = 0; p < partitions; p++) {
+    if (p == id)
+      continue;
+
+    ac_tlm2_shm_mailbox& m = region->mailbox[p][id];
+    uint32_t expected = MAILBOX_REQUEST;
+
+    // SERVING keeps a nested serve() from taking the same request
+    if (!__atomic_compare_exchange_n(&m.state, &expected, (uint32_t) MAILBOX_SERVING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      continue;
+
+    ac_tlm2_payload payload;
+    sc_time now = sc_time_stamp();
+    sc_time at = from_ps(m.time);
+    sc_time delay = (at > now) ? at - now : SC_ZERO_TIME;
+
+    payload.set_command((tlm::tlm_command) m.command);
+    payload.set_address(m.address);
+    payload.set_data_ptr(m.data);
+    payload.set_data_length(m.length);
+    payload.set_streaming_width(m.length);
+    payload.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+    if ((m.target < exports.size()) && exports[m.target])
+      exports[m.target]->LOCAL_port->b_transport(payload, delay);
+    else
+      payload.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+
+    m.response = payload.get_response_status();
+    m.time = to_ps(now + delay);
+    transactions++;
+    __atomic_store_n(&m.state, (uint32_t) MAILBOX_RESPONSE, __ATOMIC_RELEASE);
+  }
+}
+
+void ac_tlm2_shm_domain::transport(unsigned partition, unsigned target,
+                                   ac_tlm2_payload& payload, sc_time& delay) {
+  unsigned length = payload.get_data_length();
+
+  if ((partition >= partitions) || (partition == id)) {
+    fprintf(stderr, "ArchC: Partition %u has no remote partition %u.\n", id, partition);
+    exit(EXIT_FAILURE);
+  }
+  if (length > AC_SHM_MAX_DATA) {
+    payload.set_response_status(tlm::TLM_BURST_ERROR_RESPONSE);
+    return;
+  }
+
+  ac_tlm2_shm_mailbox& m = region->mailbox[id][partition];
+
+  if (__atomic_load_n(&m.state, __ATOMIC_ACQUIRE) != MAILBOX_EMPTY) {
+    fprintf(stderr, "ArchC: Nested transactions from partition %u to partition %u.\n",
+            id, partition);
+    exit(EXIT_FAILURE);
+  }
+  m.target = target;
+  m.command = payload.get_command();
+  m.address = payload.get_address();
+  m.length = length;
+  m.time = to_ps(sc_time_stamp() + delay);
+  if (payload.is_write())
+    memcpy(m.data, payload.get_data_ptr(), length);
+  __atomic_store_n(&m.state, (uint32_t) MAILBOX_REQUEST, __ATOMIC_RELEASE);
+
+  // The target may be waiting for this partition: serve while waiting
+  for (unsigned spins = 0; __atomic_load_n(&m.state, __ATOMIC_ACQUIRE) != MAILBOX_RESPONSE;
+       spins++) {
+    serve();
+    if ((spins & 0xffff) == 0xffff)
+      check_alive(partition);
+    relax(spins);
+  }
+
+  if (payload.is_read())
+    memcpy(payload.get_data_ptr(), m.data, length);
+  payload.set_response_status((tlm::tlm_response_status) m.response);
+
+  sc_time now = sc_time_stamp();
+  sc_time completed = from_ps(m.time);
+  if (completed > now + delay)
+    delay = completed - now;
+
+  transactions++;
+  __atomic_store_n(&m.state, (uint32_t) MAILBOX_EMPTY, __ATOMIC_RELEASE);
+}
+
+void ac_tlm2_shm_domain::sync() {
+  while (true) {
+    wait(quantum);
+
+    uint64_t now = to_ps(sc_time_stamp());
+    __atomic_store_n(&region->time[id], now, __ATOMIC_RELEASE);
+
+    for (unsigned spins = 0; ; spins++) {
+      bool behind = false;
+
+      for (unsigned p = 0; p < partitions; p++)
+        if ((p != id) && !__atomic_load_n(&region->done[p], __ATOMIC_ACQUIRE) &&
+            (__atomic_load_n(&region->time[p], __ATOMIC_ACQUIRE) < now)) {
+          behind = true;
+          if ((spins & 0xffff) == 0xffff)
+            check_alive(p);
+        }
+      if (!behind)
+        break;
+      serve();
+      relax(spins);
+    }
+
+    if (passive && others_done()) {
+      sc_stop();
+      return;
+    }
+  }
+}
+
+void ac_tlm2_shm_domain::end_of_simulation() {
+  // The others may still use the targets of this partition
+  __atomic_store_n(&region->done[id], 1, __ATOMIC_RELEASE);
+  for (unsigned spins = 0; !others_done(); spins++) {
+    serve();
+    if ((spins & 0xffff) == 0xffff)
+      for (unsigned p = 0; p < partitions; p++)
+        if (p != id)
+          check_alive(p);
+    relax(spins);
+  }
+  shm_unlink(domain.c_str());
+
+  fprintf(stderr, "ArchC: Partition %u of domain '%s': %llu remote transactions.\n",
+          id, domain.c_str() + 1, transactions);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+ac_tlm2_shm_export::ac_tlm2_shm_export(sc_module_name nm, ac_tlm2_shm_domain& domain,
+                                       unsigned target) :
+  sc_module(nm), LOCAL_port("LOCAL_port") {
+  domain.add_export(target, this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+ac_tlm2_shm_proxy::ac_tlm2_shm_proxy(sc_module_name nm, ac_tlm2_shm_domain& domain,
+                                     unsigned partition, unsigned target) :
+  sc_module(nm), LOCAL_target_socket("LOCAL_target_socket"), domain(domain),
+  partition(partition), target(target) {
+  LOCAL_target_socket.register_b_transport(this, &ac_tlm2_shm_proxy::b_transport);
+  LOCAL_target_socket.register_nb_transport_fw(this, &ac_tlm2_shm_proxy::nb_transport_fw);
+  SC_THREAD(respond);
+}
+
+void ac_tlm2_shm_proxy::b_transport(ac_tlm2_payload& payload, sc_time& delay) {
+  domain.transport(partition, target, payload, delay);
+}
+
+tlm::tlm_sync_enum ac_tlm2_shm_proxy::nb_transport_fw(ac_tlm2_payload& payload,
+                                                      tlm::tlm_phase& phase, sc_time& delay) {
+  if (phase != tlm::BEGIN_REQ)
+    return tlm::TLM_COMPLETED;
+
+  // Done at once, answered backwards after the delay of the target
+  domain.transport(partition, target, payload, delay);
+  responses.push_back(&payload);
+  respond_event.notify(delay);
+  phase = tlm::END_REQ;
+  return tlm::TLM_UPDATED;
+}
+
+void ac_tlm2_shm_proxy::respond() {
+  while (true) {
+    wait(respond_event);
+    while (!responses.empty()) {
+      ac_tlm2_payload *payload = responses.front();
+      tlm::tlm_phase phase = tlm::BEGIN_RESP;
+      sc_time delay = SC_ZERO_TIME;
+
+      responses.pop_front();
+      LOCAL_target_socket->nb_transport_bw(*payload, phase, delay);
+    }
+  }
+}
@@ -0,0 +1,255 @@
+/**
+ * @file      ac_batch.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Batch mode: many independent simulations from one simulator
+ *            process.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_batch.H"
+#include "ac_trace.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// using statements
+using std::string;
+using std::vector;
+using std::map;
+
+//////////////////////////////////////////////////////////////////////////////
+
+unsigned ac_batch_job = 0;
+
+extern ac_trace_writer trace_file;
+
+/// Arguments of the job of this process: av[0], the options given to the
+/// simulator and the line of the job.
+static vector<string> job_args;
+
+/// Builds an argument vector from job_args. ac_init_app() shifts the
+/// arguments it consumes, so each processor gets its own copy.
+static char** make_argv(int& ac)
+{
+  char** av = new char*[job_args.size() + 2];
+
+  ac = job_args.size();
+  for (unsigned i = 0; i < job_args.size(); i++)
+    av[i] = strdup(job_args[i].c_str());
+  av[ac] = av[ac + 1] = 0;
+  return av;
+}
+
+char* ac_batch_name(const char* file)
+{
+  std::ostringstream name;
+
+  name << file;
+  if (ac_batch_job)
+    name << "." << ac_batch_job;
+  return strdup(name.str().c_str());
+}
+
+/// Options naming an output file, which every job would overwrite. The
+/// file name ends the option, or comes before its last comma.
+static const struct {
+  const char* prefix;
+  bool before_comma;
+} output_options[] = {
+  {"--profile=", false},
+  {"--phase-flamegraph=", false},
+  {"--checkpoint-save=", true},
+  {"--trace-cache=", false}
+};
+
+/// Gives the output file named by a shared option the suffix .<n> of the
+/// job, as its stdout and stderr.
+static string job_option(const string& arg, unsigned n)
+{
+  std::ostringstream suffix;
+
+  suffix << "." << n;
+  for (unsigned i = 0; i < sizeof(output_options) / sizeof(output_options[0]); i++) {
+    size_t len = strlen(output_options[i].prefix);
+    if (arg.compare(0, len, output_options[i].prefix) != 0)
+      continue;
+
+    size_t end = output_options[i].before_comma ? arg.rfind(',') : arg.size();
+    if ((end == string::npos) || (end <= len))
+      return arg;
+    return arg.substr(0, end) + suffix.str() + arg.substr(end);
+  }
+  return arg;
+}
+
+/// Lines of the jobs file, without blank lines and # comments.
+static vector<string> read_jobs(const char* path)
+{
+  std::ifstream in(path);
+  vector<string> jobs;
+  string line;
+
+  if (!in) {
+    std::cerr << "ArchC: Could not read the jobs file '" << path << "'." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  while (std::getline(in, line)) {
+    size_t first = line.find_first_not_of(" \t\r");
+    if ((first != string::npos) && (line[first] != '#'))
+      jobs.push_back(line.substr(first));
+  }
+  return jobs;
+}
+
+/// Sends the output of the job to <jobs>.<n>.out and <jobs>.<n>.err.
+static void redirect(const char* jobs_file, unsigned n)
+{
+  std::ostringstream out, err;
+  int fd;
+
+  out << jobs_file << "." << n << ".out";
+  err << jobs_file << "." << n << ".err";
+  if (((fd = open("/dev/null", O_RDONLY)) < 0) || (dup2(fd, 0) < 0) || (close(fd) != 0) ||
+      ((fd = open(out.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) ||
+      (dup2(fd, 1) < 0) || (close(fd) != 0) ||
+      ((fd = open(err.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) ||
+      (dup2(fd, 2) < 0) || (close(fd) != 0)) {
+    perror("ArchC: Could not open the output files of a batch job");
+    _exit(EXIT_FAILURE);
+  }
+}
+
+void ac_batch_start(int& ac, char**& av)
+{
+  struct running {
+    unsigned n;
+    struct timeval start;
+  };
+
+  map<pid_t, running> children;
+  vector<string> jobs;
+  vector<string> common;
+  char* jobs_file = 0;
+  unsigned workers = 0, next = 0, failed = 0;
+  int i;
+
+  // A second processor of the platform is initialized: same job
+  if (ac_batch_job) {
+    av = make_argv(ac);
+    return;
+  }
+
+  for (i = 1; i < ac; i++)
+    if (!strncmp(av[i], "--batch=", 8))
+      break;
+  if (i == ac)
+    return;
+
+  // The children would share the trace file, and none of them would have
+  // the thread writing it
+  if (trace_file.is_open()) {
+    std::cerr << "ArchC: --batch must split the simulation before the trace is opened." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  jobs_file = strdup(av[i] + 8);
+  char* comma = strchr(jobs_file, ',');
+  if (comma) {
+    *comma = '\0';
+    workers = strtoul(comma + 1, NULL, 0);
+  }
+  if (workers == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = (cpus > 0) ? cpus : 1;
+  }
+  for (int j = 0; j < ac; j++)
+    if (j != i)
+      common.push_back(av[j]);
+  jobs = read_jobs(jobs_file);
+
+  std::cerr << "ArchC: Running " << jobs.size() << " batch jobs from '" << jobs_file
+            << "', " << workers << " at a time." << std::endl;
+
+  while ((next < jobs.size()) || !children.empty()) {
+    while ((children.size() < workers) && (next < jobs.size())) {
+      running r;
+
+      r.n = ++next;
+      gettimeofday(&r.start, NULL);
+      fflush(NULL);
+      std::cout.flush();
+      std::cerr.flush();
+
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("ArchC: Could not start a batch job");
+        exit(EXIT_FAILURE);
+      }
+      if (pid == 0) {
+        std::istringstream line(jobs[r.n - 1]);
+        string arg;
+
+        redirect(jobs_file, r.n);
+        ac_batch_job = r.n;
+        for (unsigned j = 0; j < common.size(); j++)
+          job_args.push_back(job_option(common[j], r.n));
+        while (line >> arg)
+          job_args.push_back(arg);
+        av = make_argv(ac);
+        return;
+      }
+      children[pid] = r;
+    }
+
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      perror("ArchC: Lost the batch jobs");
+      exit(EXIT_FAILURE);
+    }
+    if (children.find(pid) == children.end())
+      continue;
+
+    running r = children[pid];
+    struct timeval now;
+    children.erase(pid);
+    gettimeofday(&now, NULL);
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if (status != 0)
+      failed++;
+    fprintf(stderr, "ArchC: Job %u (%s): exit status %d, %.2f s\n", r.n, jobs[r.n - 1].c_str(),
+            status, (now.tv_sec - r.start.tv_sec) + (now.tv_usec - r.start.tv_usec) / 1e6);
+  }
+
+  fprintf(stderr, "ArchC: %u of %u batch jobs failed.\n", failed, (unsigned) jobs.size());
+  exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
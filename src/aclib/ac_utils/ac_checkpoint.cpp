@@ -0,0 +1,351 @@
+/**
+ * @file      ac_checkpoint.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Simulator checkpoint files.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include <vector>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_checkpoint.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// using statements
+using std::map;
+using std::vector;
+
+//////////////////////////////////////////////////////////////////////////////
+
+char* ac_checkpoint_save_file = 0;
+unsigned long long ac_checkpoint_save_at = 0;
+char* ac_checkpoint_restore_file = 0;
+
+/// A file opened by the guest program.
+struct ac_guest_file {
+  string path;
+  int flags;
+  int mode;
+};
+
+static map<int, ac_guest_file>& guest_files() {
+  static map<int, ac_guest_file> files;
+  return files;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+ac_checkpoint::ac_checkpoint() : file(0), writing(false), ok(false) {}
+
+ac_checkpoint::~ac_checkpoint() {
+  close();
+}
+
+bool ac_checkpoint::create(const char* name) {
+  filename = name;
+  if (!(file = fopen(name, "wb"))) {
+    fprintf(stderr, "ArchC: Could not create checkpoint file '%s': %s\n", name, strerror(errno));
+    return ok = false;
+  }
+  writing = ok = true;
+  put_raw(AC_CHECKPOINT_MAGIC, 6);
+  put((uint32_t) AC_CHECKPOINT_VERSION);
+  return ok;
+}
+
+bool ac_checkpoint::open(const char* name) {
+  char magic[6];
+  uint32_t version = 0;
+
+  filename = name;
+  int fd = ::open(name, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ArchC: Could not open checkpoint file '%s': %s\n", name, strerror(errno));
+    return ok = false;
+  }
+  // Keep low descriptors free for the guest files that will be reopened.
+  int high = fcntl(fd, F_DUPFD, 256);
+  if (high >= 0) {
+    ::close(fd);
+    fd = high;
+  }
+  file = fdopen(fd, "rb");
+  writing = false;
+  ok = true;
+  get_raw(magic, 6);
+  get(version);
+  if (!ok || memcmp(magic, AC_CHECKPOINT_MAGIC, 6) || version != AC_CHECKPOINT_VERSION) {
+    fprintf(stderr, "ArchC: '%s' is not a valid checkpoint file.\n", name);
+    ok = false;
+  }
+  return ok;
+}
+
+bool ac_checkpoint::close() {
+  if (file) {
+    if (fclose(file) != 0)
+      ok = false;
+    file = 0;
+  }
+  return ok;
+}
+
+void ac_checkpoint::put_raw(const void* p, size_t n) {
+  if (ok && fwrite(p, 1, n, file) != n)
+    ok = false;
+}
+
+void ac_checkpoint::get_raw(void* p, size_t n) {
+  if (ok && fread(p, 1, n, file) != n)
+    ok = false;
+}
+
+void ac_checkpoint::put_string(const string& s) {
+  put((uint32_t) s.size());
+  put_raw(s.data(), s.size());
+}
+
+void ac_checkpoint::get_string(string& s) {
+  uint32_t n = 0;
+
+  get(n);
+  if (!ok)
+    return;
+  vector<char> buf(n + 1, 0);
+  get_raw(&buf[0], n);
+  s.assign(&buf[0], n);
+}
+
+void ac_checkpoint::section(const char* name) {
+  if (writing) {
+    put_string(name);
+    return;
+  }
+
+  string s;
+  get_string(s);
+  if (ok && s != name) {
+    fprintf(stderr, "ArchC: Checkpoint '%s' does not match this simulator "
+            "(found section '%s', expected '%s').\n", filename.c_str(), s.c_str(), name);
+    ok = false;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+// PackBits: a control byte c < 128 is followed by c+1 literal bytes, a
+// control byte c > 128 is followed by one byte repeated 257-c times.
+
+static size_t packbits(const unsigned char* in, size_t n, unsigned char* out) {
+  size_t i = 0, o = 0;
+
+  while (i < n) {
+    size_t run = 1;
+    while (i + run < n && run < 128 && in[i + run] == in[i])
+      run++;
+
+    if (run >= 2) {
+      out[o++] = (unsigned char) (257 - run);
+      out[o++] = in[i];
+      i += run;
+    }
+    else {
+      size_t start = i, len = 0;
+      while (i < n && len < 128 && !(i + 1 < n && in[i + 1] == in[i])) {
+        i++;
+        len++;
+      }
+      if (!len) {
+        i++;
+        len = 1;
+      }
+      out[o++] = (unsigned char) (len - 1);
+      memcpy(out + o, in + start, len);
+      o += len;
+    }
+  }
+  return o;
+}
+
+static bool unpackbits(const unsigned char* in, size_t n, unsigned char* out, size_t size) {
+  size_t i = 0, o = 0;
+
+  while (i < n) {
+    unsigned c = in[i++];
+    if (c < 128) {
+      if (i + c + 1 > n || o + c + 1 > size)
+        return false;
+      memcpy(out + o, in + i, c + 1);
+      i += c + 1;
+      o += c + 1;
+    }
+    else if (c > 128) {
+      if (i >= n || o + 257 - c > size)
+        return false;
+      memset(out + o, in[i++], 257 - c);
+      o += 257 - c;
+    }
+  }
+  return o == size;
+}
+
+void ac_checkpoint::put_memory(const unsigned char* data, uint32_t size,
+                              const unsigned char* present) {
+  vector<unsigned char> packed(2 * AC_CHECKPOINT_PAGE_SIZE);
+  static const unsigned char zero[AC_CHECKPOINT_PAGE_SIZE] = { 0 };
+
+  put(size);
+  for (uint32_t page = 0; page * AC_CHECKPOINT_PAGE_SIZE < size; page++) {
+    const unsigned char* p = data + page * AC_CHECKPOINT_PAGE_SIZE;
+    uint32_t len = size - page * AC_CHECKPOINT_PAGE_SIZE;
+    if (len > AC_CHECKPOINT_PAGE_SIZE)
+      len = AC_CHECKPOINT_PAGE_SIZE;
+
+    if ((present && !present[page]) || !memcmp(p, zero, len))
+      continue;
+
+    uint32_t plen = packbits(p, len, &packed[0]);
+    put(page);
+    if (plen < len) {
+      put((uint8_t) 1);
+      put(plen);
+      put_raw(&packed[0], plen);
+    }
+    else {
+      put((uint8_t) 0);
+      put(len);
+      put_raw(p, len);
+    }
+  }
+  put((uint32_t) ~0U);
+}
+
+void ac_checkpoint::get_memory(unsigned char* data, uint32_t size, bool cleared) {
+  vector<unsigned char> packed(2 * AC_CHECKPOINT_PAGE_SIZE);
+  uint32_t saved_size = 0, page, len;
+  uint8_t encoding;
+
+  get(saved_size);
+  if (ok && saved_size != size) {
+    fprintf(stderr, "ArchC: Checkpoint '%s' has a memory of %u bytes, expected %u.\n",
+            filename.c_str(), saved_size, size);
+    ok = false;
+  }
+  if (!ok)
+    return;
+
+  if (!cleared)
+    memset(data, 0, size);
+  for (;;) {
+    get(page);
+    if (!ok || page == ~0U)
+      break;
+    get(encoding);
+    get(len);
+    uint32_t offset = page * AC_CHECKPOINT_PAGE_SIZE;
+    uint32_t page_len = offset < size ? size - offset : 0;
+    if (page_len > AC_CHECKPOINT_PAGE_SIZE)
+      page_len = AC_CHECKPOINT_PAGE_SIZE;
+    if (!ok || !page_len || len > packed.size()) {
+      ok = false;
+      break;
+    }
+    get_raw(&packed[0], len);
+    if (encoding == 0 && len == page_len)
+      memcpy(data + offset, &packed[0], len);
+    else if (encoding != 1 || !unpackbits(&packed[0], len, data + offset, page_len))
+      ok = false;
+  }
+  if (!ok)
+    fprintf(stderr, "ArchC: Checkpoint '%s' has a corrupted memory image.\n", filename.c_str());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void ac_checkpoint::file_opened(int fd, const char* path, int flags, int mode) {
+  ac_guest_file f;
+
+  f.path = path;
+  f.flags = flags & ~(O_CREAT | O_EXCL | O_TRUNC);
+  f.mode = mode;
+  guest_files()[fd] = f;
+}
+
+void ac_checkpoint::file_closed(int fd) {
+  guest_files().erase(fd);
+}
+
+void ac_checkpoint::put_files() {
+  map<int, ac_guest_file>& files = guest_files();
+
+  put((uint32_t) files.size());
+  for (map<int, ac_guest_file>::iterator it = files.begin(); it != files.end(); it++) {
+    put((int32_t) it->first);
+    put((int32_t) it->second.flags);
+    put((int32_t) it->second.mode);
+    put((int64_t) lseek(it->first, 0, SEEK_CUR));
+    put_string(it->second.path);
+  }
+}
+
+void ac_checkpoint::get_files() {
+  uint32_t n = 0;
+
+  get(n);
+  for (uint32_t i = 0; ok && i < n; i++) {
+    int32_t fd, flags, mode;
+    int64_t offset;
+    string path;
+
+    get(fd);
+    get(flags);
+    get(mode);
+    get(offset);
+    get_string(path);
+    if (!ok)
+      break;
+
+    int host_fd = ::open(path.c_str(), flags, mode);
+    if (host_fd < 0) {
+      fprintf(stderr, "ArchC: Could not reopen guest file '%s': %s\n", path.c_str(), strerror(errno));
+      ok = false;
+      break;
+    }
+    if (host_fd != fd) {
+      if (fcntl(fd, F_GETFD) != -1) {
+        fprintf(stderr, "ArchC: Could not reopen guest file '%s': descriptor %d is in use.\n",
+                path.c_str(), fd);
+        ::close(host_fd);
+        ok = false;
+        break;
+      }
+      dup2(host_fd, fd);
+      ::close(host_fd);
+    }
+    lseek(fd, offset, SEEK_SET);
+    file_opened(fd, path.c_str(), flags, mode);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
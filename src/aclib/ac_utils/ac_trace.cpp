@@ -0,0 +1,225 @@
+/**
+ * @file      ac_trace.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Binary instruction trace writer and reader.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Standard includes
+#include <string.h>
+#include <stdlib.h>
+
+// SystemC includes
+
+// ArchC includes
+#include "ac_trace.H"
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Writer
+
+ac_trace_writer::ac_trace_writer() :
+  file(0), memory(false), active(0), pos(0), io_buffer(0), io_length(0),
+  io_busy(false), stopping(false), in_block(false), block_start(0),
+  block_count(0), block_size(0), next_pc(0), expected_pc(0), last_addr(0) {
+  buffer[0] = buffer[1] = 0;
+}
+
+ac_trace_writer::~ac_trace_writer() {
+  close();
+}
+
+bool ac_trace_writer::open(const char* filename) {
+  unsigned char header[12];
+
+  close();
+
+  if (!(file = fopen(filename, "wb")))
+    return false;
+
+  buffer[0] = (unsigned char*) malloc(AC_TRACE_BUFFER_SIZE);
+  buffer[1] = (unsigned char*) malloc(AC_TRACE_BUFFER_SIZE);
+  active = 0;
+  pos = 0;
+  in_block = false;
+  expected_pc = 0;
+  last_addr = 0;
+  io_busy = false;
+  stopping = false;
+
+  memcpy(header, AC_TRACE_MAGIC, 8);
+  for (int i = 0; i < 4; i++)
+    header[8 + i] = (unsigned char) (AC_TRACE_VERSION >> (8 * i));
+  fwrite(header, 1, sizeof(header), file);
+
+  pthread_mutex_init(&lock, 0);
+  pthread_cond_init(&cond, 0);
+  pthread_create(&io_thread, 0, io_main, this);
+  return true;
+}
+
+void ac_trace_writer::close() {
+  if (!file)
+    return;
+
+  flush_block();
+  put(AC_TRACE_END);
+  submit();
+
+  pthread_mutex_lock(&lock);
+  stopping = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  pthread_join(io_thread, 0);
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&lock);
+
+  fclose(file);
+  file = 0;
+  free(buffer[0]);
+  free(buffer[1]);
+  buffer[0] = buffer[1] = 0;
+}
+
+void* ac_trace_writer::io_main(void* arg) {
+  ((ac_trace_writer*) arg)->io_loop();
+  return 0;
+}
+
+void ac_trace_writer::io_loop() {
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    while (!io_busy && !stopping)
+      pthread_cond_wait(&cond, &lock);
+    if (io_busy) {
+      unsigned char* b = io_buffer;
+      unsigned l = io_length;
+      pthread_mutex_unlock(&lock);
+      fwrite(b, 1, l, file);
+      pthread_mutex_lock(&lock);
+      io_busy = false;
+      pthread_cond_broadcast(&cond);
+    }
+    else if (stopping)
+      break;
+  }
+  pthread_mutex_unlock(&lock);
+  fflush(file);
+}
+
+/// Hands the active buffer to the I/O thread and switches to the other one.
+void ac_trace_writer::submit() {
+  pthread_mutex_lock(&lock);
+  while (io_busy)
+    pthread_cond_wait(&cond, &lock);
+  io_buffer = buffer[active];
+  io_length = pos;
+  io_busy = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+
+  active ^= 1;
+  pos = 0;
+}
+
+void ac_trace_writer::flush_block() {
+  if (!in_block)
+    return;
+  reserve();
+  put(AC_TRACE_BLOCK);
+  put_varint(block_count);
+  put((unsigned char) block_size);
+  put_delta(expected_pc, block_start);
+  expected_pc = block_start + block_count * block_size;
+  in_block = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Reader
+
+ac_trace_reader::ac_trace_reader() : file(0), expected_pc(0), last_addr(0) {}
+
+ac_trace_reader::~ac_trace_reader() {
+  if (file)
+    fclose(file);
+}
+
+bool ac_trace_reader::open(const char* filename) {
+  unsigned char header[12];
+  unsigned version = 0;
+
+  if (!(file = fopen(filename, "rb")))
+    return false;
+
+  if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+      memcmp(header, AC_TRACE_MAGIC, 8) != 0)
+    return false;
+
+  for (int i = 3; i >= 0; i--)
+    version = (version << 8) | header[8 + i];
+  return version == AC_TRACE_VERSION;
+}
+
+bool ac_trace_reader::get_varint(unsigned& v) {
+  int c, shift = 0;
+
+  v = 0;
+  do {
+    if ((c = fgetc(file)) == EOF)
+      return false;
+    v |= (unsigned) (c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+  return true;
+}
+
+static inline unsigned unzigzag(unsigned v) {
+  return (v >> 1) ^ (unsigned) -(int) (v & 1);
+}
+
+bool ac_trace_reader::next(ac_trace_record& r) {
+  int tag, size;
+  unsigned delta;
+
+  if (!file || (tag = fgetc(file)) == EOF)
+    return false;
+
+  r.tag = (ac_trace_tag) tag;
+  switch (tag) {
+  case AC_TRACE_BLOCK:
+    if (!get_varint(r.count) || (size = fgetc(file)) == EOF || !get_varint(delta))
+      return false;
+    r.size = size;
+    r.addr = expected_pc + unzigzag(delta);
+    expected_pc = r.addr + r.count * r.size;
+    return true;
+
+  case AC_TRACE_READ:
+  case AC_TRACE_WRITE:
+    if ((size = fgetc(file)) == EOF || !get_varint(delta))
+      return false;
+    r.size = size;
+    r.count = 0;
+    r.addr = last_addr + unzigzag(delta);
+    last_addr = r.addr;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
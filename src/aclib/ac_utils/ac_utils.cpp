@@ -40,7 +40,7 @@
 // int ac_exit_status = 0;
 
 //Declaring trace variables
-ofstream trace_file;
+ac_trace_writer trace_file;
 bool ac_do_trace;
 
 //Command line arguments used inside ArchC Simulator
@@ -49,6 +49,24 @@ char **ac_argv;
 //Name of the file containing the application to be loaded.
 char *appfilename;
 std::map<std::string, std::ofstream*> ac_cache_traces;
+//Name of the guest profile file (--profile=<file>), 0 if profiling is off.
+char *ac_profile_file = 0;
+//Set while the SIGUSR1 handler runs, so the profiler defers its dump.
+volatile sig_atomic_t ac_profile_defer = 0;
+//Sampled simulation parameters (--sample=<period>,<warmup>,<window>), 0 if off.
+char *ac_sample_spec = 0;
+//Threads used to pre-decode the application (--predecode[=<threads>]), 0 if off.
+unsigned ac_predecode_threads = 0;
+//Directory of the dynamic linking cache (--prelink-cache=<dir>), 0 if off.
+char *ac_prelink_cache_dir = 0;
+//Run memcpy, memset, strlen... of the guest on the host (--native-libc).
+bool ac_native_libc = false;
+//Folded stacks file of the phase times (--phase-flamegraph=<file>), 0 if none.
+char *ac_phase_folded_file = 0;
+
+const char *ac_native_names[AC_NATIVE_NUMBER] = {
+  "memcpy", "memmove", "memset", "strlen", "strcmp"
+};
 
 //Read model options before application
 void ac_init_opt( int ac, char* av[]){
@@ -69,6 +87,16 @@ void ac_init_opt( int ac, char* av[]){
       cerr << "  --version               Display ArchC version and options used when built\n";
       cerr << "  --load=<prog_path>      Load target application\n";
       cerr << "  --trace-cache=<cache>,<file> Trace cache access\n";
+      cerr << "  --trace-mem             Record memory accesses in the binary trace (needs acsim -g)\n";
+      cerr << "  --checkpoint-save=<file>,<n>  Save a checkpoint after n instructions (needs acsim --checkpoint)\n";
+      cerr << "  --checkpoint-restore=<file>   Start from a checkpoint (needs acsim --checkpoint)\n";
+      cerr << "  --profile=<file>        Write a guest code profile to file (needs acsim --profile)\n";
+      cerr << "  --sample=<period>,<warmup>,<window>  Fast-forward and measure one window per period (needs acsim --sampling)\n";
+      cerr << "  --predecode[=<threads>] Decode the whole text segment at load time (all cores by default)\n";
+      cerr << "  --prelink-cache=<dir>   Reuse the linked image of a dynamic application across runs\n";
+      cerr << "  --native-libc           Run memcpy, memmove, memset, strlen and strcmp of the application on the host\n";
+      cerr << "  --phase-flamegraph=<file>  Write the host time of each phase as folded stacks (needs acsim --phase-timers)\n";
+      cerr << "  --batch=<jobs>[,<workers>]  Run the simulations listed in file jobs, one per line, workers at a time (all cores by default)\n";
 #ifdef USE_GDB
 //      cerr << "  --gdb[=<port>]          Enable GDB support\n";
 #endif /* USE_GDB */
@@ -149,6 +177,115 @@ void ac_init_app( int ac, char* av[]){
 	ac--;
 	continue;
     }
+    else if ( (size==11) && (!strncmp(av[1], "--trace-mem", 11)) ) {
+	trace_file.set_memory(true);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size>18) && (!strncmp(av[1], "--checkpoint-save=", 18)) ) {
+	char *comma = strrchr(av[1], ',');
+	if (comma == NULL) {
+		std::cerr << "Error: invalid argument syntax.\n";
+		exit(EXIT_FAILURE);
+	}
+	ac_checkpoint_save_file = (char*) malloc(comma - (av[1]+18) + 1);
+	strncpy(ac_checkpoint_save_file, av[1]+18, comma - (av[1]+18));
+	ac_checkpoint_save_file[comma - (av[1]+18)] = '\0';
+	ac_checkpoint_save_at = strtoull(comma+1, NULL, 0);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size>21) && (!strncmp(av[1], "--checkpoint-restore=", 21)) ) {
+	ac_checkpoint_restore_file = (char*) malloc(size - 20);
+	strcpy(ac_checkpoint_restore_file, av[1]+21);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( ((size==11) || (size>12)) && (!strncmp(av[1], "--predecode", 11))
+              && (av[1][11] == '\0' || av[1][11] == '=') ) {
+	if (size > 12)
+		ac_predecode_threads = strtoul(av[1]+12, NULL, 0);
+	else {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		ac_predecode_threads = (cpus > 0) ? cpus : 1;
+	}
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size>16) && (!strncmp(av[1], "--prelink-cache=", 16)) ) {
+	ac_prelink_cache_dir = (char*) malloc(size - 15);
+	strcpy(ac_prelink_cache_dir, av[1]+16);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size>19) && (!strncmp(av[1], "--phase-flamegraph=", 19)) ) {
+	ac_phase_folded_file = (char*) malloc(size - 18);
+	strcpy(ac_phase_folded_file, av[1]+19);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size==13) && (!strncmp(av[1], "--native-libc", 13)) ) {
+	ac_native_libc = true;
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size>9) && (!strncmp(av[1], "--sample=", 9)) ) {
+	ac_sample_spec = (char*) malloc(size - 8);
+	strcpy(ac_sample_spec, av[1]+9);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
+    else if ( (size>10) && (!strncmp(av[1], "--profile=", 10)) ) {
+	ac_profile_file = (char*) malloc(size - 9);
+	strcpy(ac_profile_file, av[1]+10);
+	// Remove this parameter from the list and reset the loop
+	for (int i = 1; i <= ac; i++) {
+		av[i] = av[i+1];
+	}
+	ac_argc--;
+	ac--;
+	continue;
+    }
 
     ac --;
     av ++;
@@ -182,3 +319,55 @@ unsigned int convert_endian(unsigned int size, unsigned int num, bool match_endi
 
   return out;
 }
+
+void ac_native_resolve(int fd, const Elf32_Ehdr& ehdr, bool match_endian, ac_native_table& table)
+{
+  unsigned shoff = convert_endian(4, ehdr.e_shoff, match_endian);
+  unsigned shnum = convert_endian(2, ehdr.e_shnum, match_endian);
+  unsigned shentsize = convert_endian(2, ehdr.e_shentsize, match_endian);
+  Elf32_Shdr symtab, strtab;
+  unsigned i;
+
+  //Find the symbol table and its string table
+  for (i = 0; i < shnum; i++) {
+    if ((pread(fd, &symtab, sizeof(symtab), shoff + shentsize * i) != sizeof(symtab)))
+      return;
+    if (convert_endian(4, symtab.sh_type, match_endian) == SHT_SYMTAB)
+      break;
+  }
+  if (i == shnum) {
+    AC_WARN("--native-libc: the application has no symbol table.");
+    return;
+  }
+  if (pread(fd, &strtab, sizeof(strtab), shoff + shentsize * convert_endian(4, symtab.sh_link, match_endian)) != sizeof(strtab))
+    return;
+
+  std::vector<char> names(convert_endian(4, strtab.sh_size, match_endian) + 1, '\0');
+  std::vector<Elf32_Sym> syms(convert_endian(4, symtab.sh_size, match_endian) / sizeof(Elf32_Sym));
+  if ((pread(fd, &names[0], names.size() - 1, convert_endian(4, strtab.sh_offset, match_endian)) != (ssize_t) names.size() - 1) ||
+      (syms.size() && (pread(fd, &syms[0], syms.size() * sizeof(Elf32_Sym), convert_endian(4, symtab.sh_offset, match_endian)) != (ssize_t) (syms.size() * sizeof(Elf32_Sym))))) {
+    AC_WARN("--native-libc: could not read the symbol table.");
+    return;
+  }
+
+  for (i = 0; i < syms.size(); i++) {
+    unsigned name = convert_endian(4, syms[i].st_name, match_endian);
+    unsigned value = convert_endian(4, syms[i].st_value, match_endian);
+
+    if ((ELF32_ST_TYPE(syms[i].st_info) != STT_FUNC) || !value || (name >= names.size()))
+      continue;
+    for (int r = 0; r < AC_NATIVE_NUMBER; r++)
+      if (!strcmp(&names[name], ac_native_names[r]) && (table.find(value) < 0)) {
+        table.addr.push_back(value);
+        table.id.push_back(r);
+        AC_SAY("Running " << ac_native_names[r] << " (0x" << std::hex << value << std::dec << ") on the host");
+      }
+  }
+}
+
+void ac_native_table::print_stats() const
+{
+  for (int r = 0; r < AC_NATIVE_NUMBER; r++)
+    if (calls[r])
+      fprintf(stderr, "    Native %s: %llu calls, %llu bytes\n", ac_native_names[r], calls[r], bytes[r]);
+}
@@ -0,0 +1,159 @@
+/* ex: set tabstop=2 expandtab:
+   -*- Mode: C; tab-width: 2; indent-tabs-mode nil -*-
+*/
+/**
+ * @file      ac_output.c
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Output helpers shared by the simulator generators.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ac_output.h"
+
+/*! Generated files are written to "<name>.new" and only replace <name> when their
+    contents differ, so the timestamps of unchanged sources are kept and make only
+    recompiles the translation units that really changed. */
+typedef struct _ac_output
+{
+ FILE* file;
+ char* name;
+ struct _ac_output* next;
+} ac_output;
+
+static ac_output* outputs = 0;
+int ac_outputs_written = 0;
+int ac_outputs_unchanged = 0;
+
+FILE* ac_output_open(const char* filename)
+{
+  static int registered = 0;
+  ac_output* out;
+  char* tmp = (char*) malloc(strlen(filename) + 5);
+  FILE* file;
+
+  sprintf(tmp, "%s.new", filename);
+  file = fopen(tmp, "w");
+  free(tmp);
+  if (!file)
+    return 0;
+
+  //Some files are never closed by the function that creates them
+  if (!registered) {
+    atexit(ac_output_close_all);
+    registered = 1;
+  }
+
+  out = (ac_output*) malloc(sizeof(ac_output));
+  out->file = file;
+  out->name = strdup(filename);
+  out->next = outputs;
+  outputs = out;
+  return file;
+}
+
+
+static int same_contents(const char* a, const char* b)
+{
+  FILE *fa, *fb;
+  char bufa[8192], bufb[8192];
+  size_t na, nb;
+  int same = 0;
+
+  if (!(fa = fopen(a, "rb")))
+    return 0;
+  if ((fb = fopen(b, "rb"))) {
+    do {
+      na = fread(bufa, 1, sizeof(bufa), fa);
+      nb = fread(bufb, 1, sizeof(bufb), fb);
+    } while (na == nb && na > 0 && memcmp(bufa, bufb, na) == 0);
+    same = (na == 0 && nb == 0);
+    fclose(fb);
+  }
+  fclose(fa);
+  return same;
+}
+
+
+int ac_output_close(FILE* output)
+{
+  ac_output **p, *out;
+  char* tmp;
+  int status;
+
+  for (p = &outputs; *p && (*p)->file != output; p = &(*p)->next);
+  if (!*p)
+    return fclose(output);
+  out = *p;
+  *p = out->next;
+
+  status = fclose(output);
+  tmp = (char*) malloc(strlen(out->name) + 5);
+  sprintf(tmp, "%s.new", out->name);
+  if ((status == 0) && same_contents(tmp, out->name)) {
+    unlink(tmp);
+    ac_outputs_unchanged++;
+  }
+  else if (rename(tmp, out->name) != 0) {
+    perror("ArchC could not write output file");
+    status = EOF;
+  }
+  else
+    ac_outputs_written++;
+
+  free(tmp);
+  free(out->name);
+  free(out);
+  return status;
+}
+
+
+void ac_output_close_all()
+{
+  while (outputs)
+    ac_output_close(outputs->file);
+}
+
+
+void ac_make_jobs(FILE* output)
+{
+  fprintf(output, "# Objects are compiled in parallel, JOBS=1 for a serial build\n");
+  fprintf(output, "JOBS ?= $(shell getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)\n");
+  fprintf(output, "MAKEFLAGS += -j$(JOBS)\n\n");
+
+  fprintf(output, "# Compile time of each object built, reported after linking\n");
+  fprintf(output, "COMPILE_TIMES := .ac_compile_times\n\n");
+}
+
+
+void ac_make_compile_report(FILE* output)
+{
+  fprintf(output, "\t@if [ -f $(COMPILE_TIMES) ]; then \\\n");
+  fprintf(output, "\t  echo \"ArchC: compile time per object (s):\"; sort -k2 -n -r $(COMPILE_TIMES); \\\n");
+  fprintf(output, "\t  awk -v n=$(words $(OBJS)) '{t += $$2} END {printf \"ArchC: %%d objects rebuilt in %%.2f s of compilation, %%d reused\\n\", NR, t, n - NR}' $(COMPILE_TIMES); \\\n");
+  fprintf(output, "\t  rm -f $(COMPILE_TIMES); \\\n");
+  fprintf(output, "\tfi\n\n");
+}
+
+
+void ac_make_timed_rule(FILE* output, const char* flags)
+{
+  fprintf(output, ".cpp.o:\n");
+  fprintf(output, "\t@echo \"$(CC) $(CFLAGS) $(INC_DIR) -c $<\"; t0=`date +%%s.%%N`; \\\n");
+  fprintf(output, "\t$(CC) $(CFLAGS) %s$(INC_DIR) -c $< || exit 1; \\\n", flags);
+  fprintf(output, "\tawk -v f=$@ -v t0=$$t0 -v t1=`date +%%s.%%N` 'BEGIN {printf \"%%-40s %%8.2f\\n\", f, t1 - t0}' >> $(COMPILE_TIMES)\n\n");
+}
@@ -0,0 +1,42 @@
+/* ex: set tabstop=2 expandtab:
+   -*- Mode: C; tab-width: 2; indent-tabs-mode nil -*-
+*/
+/**
+ * @file      ac_output.h
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Output helpers shared by the simulator generators.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#ifndef _AC_OUTPUT_H_
+#define _AC_OUTPUT_H_
+
+#include <stdio.h>
+
+//! Generated files: only replaced when their contents change.
+FILE* ac_output_open(const char* filename);
+int ac_output_close(FILE* output);
+void ac_output_close_all();
+
+//! Files replaced and files left unchanged by ac_output_close().
+extern int ac_outputs_written;
+extern int ac_outputs_unchanged;
+
+//! Parts of the generated Makefiles: parallel jobs and the compile time
+//! log, the compile time report run after linking, and the .cpp.o rule
+//! that logs the time of each object, compiled with the extra flags.
+void ac_make_jobs(FILE* output);
+void ac_make_compile_report(FILE* output);
+void ac_make_timed_rule(FILE* output, const char* flags);
+
+#endif
@@ -152,7 +152,7 @@ static void yywarn(const char* format, ...)
 %token <text> AC_FORMAT
 %token <text> AC_INSTR
 %token <text> CYCLE_RANGE
-%token <text> IS_JUMP IS_BRANCH COND DELAY DELAY_COND BEHAVIOR
+%token <text> IS_JUMP IS_BRANCH IS_CALL IS_RETURN COND DELAY DELAY_COND BEHAVIOR
 %token <text> AC_ASM_MAP PSEUDO_INSTR
 %token <text> AC_ASM_ASSEMBLER
 %token <text> MAP_TO
@@ -162,7 +162,7 @@ static void yywarn(const char* format, ...)
 /* ISA non-terminals */
 %type <text> input isadec isadecbody formatdeclist instrdeclist ctordec
 %type <text> formatdec instrdec ctordecbody asmdec decoderdec cyclesdec
-%type <text> is_jumpdec is_branchdec conddec delaydec delayconddec behaviordec
+%type <text> is_jumpdec is_branchdec is_calldec is_returndec conddec delaydec delayconddec behaviordec
 %type <text> fieldinitlist fieldinit rangedec interval
 %type <text> asmmaplist asmmapdec mapbodylist mapbody symbollist
 %type <text> asmcomdec asmlcomdec
@@ -446,6 +446,8 @@ ctordecbody: asmdec ctordecbody
       | rangedec ctordecbody
       | is_jumpdec ctordecbody
       | is_branchdec ctordecbody
+      | is_calldec ctordecbody
+      | is_returndec ctordecbody
       | conddec ctordecbody
       | delaydec ctordecbody
       | delayconddec ctordecbody
@@ -679,6 +681,26 @@ is_branchdec: ID DOT IS_BRANCH BLOCK SEMICOLON
       }
       ;
 
+is_calldec: ID DOT IS_CALL BLOCK SEMICOLON
+      {
+       current_instr = find_instr($1);
+       if (current_instr == NULL)
+        yyerror("Undeclared instruction: %s", $1);
+       else
+        get_control_flow_struct(current_instr)->call_ret = $4;
+      }
+      ;
+
+is_returndec: ID DOT IS_RETURN BLOCK SEMICOLON
+      {
+       current_instr = find_instr($1);
+       if (current_instr == NULL)
+        yyerror("Undeclared instruction: %s", $1);
+       else
+        get_control_flow_struct(current_instr)->return_cond = $4;
+      }
+      ;
+
 conddec: ID COND BLOCK SEMICOLON
       {
        current_instr = find_instr($1);
@@ -27,12 +27,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 
 //#define DEBUG_STORAGE
 
 //Defining Traces and Dasm strings
-#define PRINT_TRACE "%strace_file << hex << decode_pc << dec <<\"\\n\";\n"
+#define PRINT_TRACE "%strace_file.instr(decode_pc, ISA.get_size());\n"
+
+//Test emitted before the hooks of the decoded instruction are run
+#define HOOKED_INSTR (ACDecCacheFlag ? "ins_cache->hooked" : "hooks.any()")
 
 //Command-line options flags
 int  ACABIFlag=0;                               //!<Indicates whether an ABI was provided or not
@@ -47,6 +52,10 @@ int  ACVerifyFlag=0;                            //!<Indicates whether verificati
 int  ACVerifyTimedFlag=0;                       //!<Indicates whether verification option is turned on for a timed behavioral model
 int  ACGDBIntegrationFlag=0;                    //!<Indicates whether gdb support will be included in the simulator
 int  ACWaitFlag=1;                              //!<Indicates whether the instruction execution thread issues a wait() call or not
+int  ACProfileFlag=0;                           //!<Indicates whether the guest code profiler is included or not
+int  ACCheckpointFlag=0;                        //!<Indicates whether checkpoint save/restore support is included or not
+int  ACSamplingFlag=0;                          //!<Indicates whether sampled simulation support is included or not
+int  ACPhaseTimersFlag=0;                       //!<Indicates whether the host time of the simulation phases is measured or not
 
 //char *ACVersion = "2.0alpha1";                        //!<Stores ArchC version number.
 char ACOptions[500];                            //!<Stores ArchC recognized command line options
@@ -95,6 +104,10 @@ struct option_map option_map[] = {
   {"--version"       , "-vrs"        ,"Display ACSIM version.", 0},
   {"--gdb-integration", "-gdb"       ,"Enable support for debbuging programs running on the simulator.", 0},
   {"--no-wait"       , "-nw"        ,"Disable wait() at execution thread.", 0},
+  {"--profile"       , "-prof"      ,"Include the guest code profiler (enable it with --profile=<file> at run time).", 0},
+  {"--checkpoint"    , "-cp"        ,"Include checkpoint save/restore support (--checkpoint-save/--checkpoint-restore at run time).", 0},
+  {"--sampling"      , "-smp"       ,"Include sampled simulation support (enable it with --sample=<period>,<warmup>,<window> at run time).", 0},
+  {"--phase-timers"  , "-pt"        ,"Measure the host time spent decoding, executing behaviors, accessing memory, in system calls and waits.", 0},
   0
 };
 
@@ -202,6 +215,9 @@ int main(int argc, char** argv) {
   endian a, b;
 
   int error_flag=0;
+  struct timeval gen_start, gen_end;
+
+  gettimeofday(&gen_start, NULL);
 
   //Uncomment the line bellow if you want to debug the parser.
   //yydebug =1;
@@ -291,6 +307,22 @@ int main(int argc, char** argv) {
               ACWaitFlag = 0;
               ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
               break;
+            case OPProfile:
+              ACProfileFlag = 1;
+              ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
+              break;
+            case OPCheckpoint:
+              ACCheckpointFlag = 1;
+              ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
+              break;
+            case OPSampling:
+              ACSamplingFlag = 1;
+              ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
+              break;
+            case OPPhaseTimers:
+              ACPhaseTimersFlag = 1;
+              ACOptions_p += sprintf( ACOptions_p, "%s ", argv[0]);
+              break;
 
             default:
               break;
@@ -391,6 +423,19 @@ int main(int argc, char** argv) {
     GetFetchDevice();
     GetLoadDevice();
 
+    //Checkpoints hold the functional state only.
+    {
+      extern int HaveMultiCycleIns, HaveMemHier;
+      if( ACCheckpointFlag && (stage_list || pipe_list || HaveMultiCycleIns || HaveMemHier || ACDelayFlag) ){
+        AC_ERROR("Checkpoints are not supported for pipelined, multicycle, delayed or memory hierarchy models.\n");
+        return EXIT_FAILURE;
+      }
+      if( ACSamplingFlag && (stage_list || pipe_list || HaveMultiCycleIns) ){
+        AC_ERROR("Sampled simulation is not supported for pipelined or multicycle models.\n");
+        return EXIT_FAILURE;
+      }
+    }
+
     //Creating Resources Header File
     CreateArchHeader();
     CreateArchRefHeader();
@@ -480,8 +525,14 @@ int main(int argc, char** argv) {
 		
       /* Create dummy functions to use if real ones are undefined */
 		
+      ac_output_close_all();
+      gettimeofday(&gen_end, NULL);
+
       //Issuing final messages to the user.
       AC_MSG("%s model files generated.\n", project_name);
+      AC_MSG("Generation took %.2f s: %d files written, %d unchanged (their objects are reused by make).\n",
+             (gen_end.tv_sec - gen_start.tv_sec) + (gen_end.tv_usec - gen_start.tv_usec) / 1e6,
+             ac_outputs_written, ac_outputs_unchanged);
     }
 
     return 0;
@@ -519,7 +570,7 @@ int main(int argc, char** argv) {
 
     sprintf(filename, "%s_arch.H", project_name);
 
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -800,7 +851,7 @@ int main(int argc, char** argv) {
     fprintf( output, "};\n\n"); //End of ac_resources class
 
     fprintf( output, "#endif  //_%s_ARCH_H\n", upper_project_name);
-    fclose( output);
+    ac_output_close(output);
 
   }
 
@@ -827,7 +878,7 @@ int main(int argc, char** argv) {
 
     sprintf(filename, "%s_arch_ref.H", project_name);
 
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1006,7 +1057,7 @@ int main(int argc, char** argv) {
     fprintf( output, "};\n\n"); //End of _arch_ref class
 
     fprintf( output, "#endif  //_%s_ARCH_REF_H\n", upper_project_name);
-    fclose( output);
+    ac_output_close(output);
 
   }
 
@@ -1032,7 +1083,7 @@ int main(int argc, char** argv) {
 
     sprintf(filename, "%s_arch_ref.cpp", project_name);
 
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1061,7 +1112,7 @@ int main(int argc, char** argv) {
       }
     }
     fprintf(output, " {}\n\n");
-    fclose( output);
+    ac_output_close(output);
     */
 
     /* Declaring storage devices */
@@ -1079,7 +1130,7 @@ int main(int argc, char** argv) {
     }
 
     fprintf(output, " {}\n\n");
-    fclose(output);
+    ac_output_close(output);
 
 
   }
@@ -1110,7 +1161,7 @@ int main(int argc, char** argv) {
     FILE *output;
 
     sprintf(filename, "%s_parms.H", project_name);
-    if ( !(output = fopen(filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1292,7 +1343,7 @@ int main(int argc, char** argv) {
     fprintf( output, "\n\n");
     fprintf( output, "#endif  //_%s_PARMS_H\n", upper_project_name);
 
-    fclose(output);
+    ac_output_close(output);
   }
 
 
@@ -1321,7 +1372,7 @@ int main(int argc, char** argv) {
 
     sprintf( filename, "%s_isa.H", project_name);
 
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1386,6 +1437,10 @@ int main(int argc, char** argv) {
 
     COMMENT(INDENT[2], "Building Decoder.");
     fprintf( output,"%sdecoder = ac_decoder_full::CreateDecoder(%s_isa::formats, %s_isa::instructions, &ref);\n", INDENT[2], project_name, project_name );
+    fprintf( output,"%sif (decoder->nFields > AC_DEC_FIELD_NUMBER) {\n", INDENT[2]);
+    fprintf( output,"%sfprintf(stderr, \"ArchC Error: decoder needs %%u fields, ac_instr holds %%u.\\n\", decoder->nFields, AC_DEC_FIELD_NUMBER);\n", INDENT[3]);
+    fprintf( output,"%sexit(EXIT_FAILURE);\n", INDENT[3]);
+    fprintf( output,"%s}\n", INDENT[2]);
 
     /* Closing constructor declaration. */
     fprintf( output,"%s}\n\n", INDENT[1] );
@@ -1465,11 +1520,11 @@ int main(int argc, char** argv) {
 
     /* END OF FILE */
     fprintf( output, "\n\n#endif //_%s_ISA_H\n\n", upper_project_name);
-    fclose( output);
+    ac_output_close(output);
 
     /* opens behavior macros file */
     sprintf( filename, "%s_bhv_macros.H", project_name);
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1537,7 +1592,7 @@ int main(int argc, char** argv) {
 
     /* END OF FILE */
     fprintf( output, "\n\n#endif //_%s_BHV_MACROS_H\n\n", upper_project_name);
-    fclose( output);
+    ac_output_close(output);
 
   }
 
@@ -1566,7 +1621,7 @@ int main(int argc, char** argv) {
 	sprintf( stage_filename, "%s.H", pstage->name);
       }
 
-      if ( !(output = fopen( stage_filename, "w"))){
+      if ( !(output = ac_output_open(stage_filename))){
 	perror("ArchC could not open output file");
 	exit(1);
       }
@@ -1662,7 +1717,7 @@ int main(int argc, char** argv) {
       fprintf( output, "}\n");
 
       fprintf( output, "#endif \n");
-      fclose(output);
+      ac_output_close(output);
       free(stage_filename);
     }
   }
@@ -1694,7 +1749,7 @@ int main(int argc, char** argv) {
 
     sprintf( filename, "%s.H", project_name);
 
-    if ( !(output = fopen( filename, "w"))){
+    if ( !(output = ac_output_open(filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -1731,6 +1786,15 @@ int main(int argc, char** argv) {
       fprintf( output, "#include \"ac_gdb.H\"\n");
     }
 
+    if (ACProfileFlag)
+      fprintf( output, "#include \"ac_profiler.H\"\n");
+
+    if (ACSamplingFlag)
+      fprintf( output, "#include \"ac_sampler.H\"\n");
+
+    if (ACDecCacheFlag)
+      fprintf( output, "#include \"ac_predecode.H\"\n");
+
     fprintf(output, "\n\n");
 
     fprintf(output, "class %s: public ac_module, public %s_arch", project_name, project_name);
@@ -1787,12 +1851,21 @@ int main(int argc, char** argv) {
 
     fprintf( output, "%sunsigned id;\n\n", INDENT[1]);
     fprintf( output, "%sbool start_up;\n", INDENT[1]);
-    fprintf( output, "%sunsigned* instr_dec;\n", INDENT[1]);
     fprintf( output, "%sac_instr_t* instr_vec;\n\n", INDENT[1]);
 
     if (ACGDBIntegrationFlag)
       fprintf(output, "%sAC_GDB<%s_parms::ac_word>* gdbstub;\n\n", INDENT[1], project_name);
 
+    if (ACProfileFlag) {
+      COMMENT(INDENT[1], "Guest code profiler, enabled with --profile=<file>.");
+      fprintf(output, "%sac_profiler profiler;\n\n", INDENT[1]);
+    }
+
+    if (ACSamplingFlag) {
+      COMMENT(INDENT[1], "Sampled simulation control, enabled with --sample=<period>,<warmup>,<window>.");
+      fprintf(output, "%sac_sampler sampler;\n\n", INDENT[1]);
+    }
+
     COMMENT(INDENT[1], "Behavior execution method.");
     fprintf( output, "%svoid behavior();\n\n", INDENT[1]);
 
@@ -1849,7 +1922,26 @@ int main(int argc, char** argv) {
     if(ACDecCacheFlag){
       fprintf( output, "%svoid init_dec_cache() {\n", INDENT[1]);  //end constructor
       fprintf( output, "%sDEC_CACHE = (cache_item_t*) calloc(sizeof(cache_item_t),dec_cache_size);\n", INDENT[2]);  //end constructor
-      fprintf( output, "%s}\n", INDENT[1]);  //end init_dec_cache
+      if( !stage_list && !pipe_list ){
+        fprintf( output, "%sac_code_pages.assign(((dec_cache_size + %s_parms::AC_MAX_BUFFER) >> AC_CODE_PAGE_BITS) + 1, 0);\n", INDENT[2], project_name);
+        EmitCodeWatch(output, 2);
+      }
+      fprintf( output, "%s}\n\n", INDENT[1]);  //end init_dec_cache
+
+      fprintf( output, "%svoid invalidate_code(unsigned addr, unsigned len) {\n", INDENT[1]);
+      fprintf( output, "%sunsigned pc = (addr >= %s_parms::AC_MAX_BUFFER) ? addr - (%s_parms::AC_MAX_BUFFER - 1) : 0;\n", INDENT[2], project_name, project_name);
+      fprintf( output, "%sunsigned end = (addr + len < dec_cache_size) ? addr + len : dec_cache_size;\n\n", INDENT[2]);
+      fprintf( output, "%sfor (; pc < end; pc++)\n", INDENT[2]);
+      fprintf( output, "%sDEC_CACHE[pc].valid = 0;\n", INDENT[3]);
+      fprintf( output, "%s}\n", INDENT[1]);
+
+      fprintf( output, "%svoid hooks_changed() {\n", INDENT[1]);
+      fprintf( output, "%sif (!DEC_CACHE)\n", INDENT[2]);
+      fprintf( output, "%sreturn;\n", INDENT[3]);
+      fprintf( output, "%sfor (unsigned pc = 0; pc < dec_cache_size; pc++)\n", INDENT[2]);
+      fprintf( output, "%sif (DEC_CACHE[pc].valid)\n", INDENT[3]);
+      fprintf( output, "%sDEC_CACHE[pc].hooked = hooks.hooked(pc, DEC_CACHE[pc].instr_p->get(IDENT));\n", INDENT[4]);
+      fprintf( output, "%s}\n", INDENT[1]);
     }
 
     if(ACGDBIntegrationFlag) {
@@ -1890,13 +1982,26 @@ int main(int argc, char** argv) {
     if (ACGDBIntegrationFlag)
       fprintf(output, "%svoid enable_gdb(int port = 5000);\n\n", INDENT[1]);
 
+    if (ACCheckpointFlag) {
+      COMMENT(INDENT[1], "Checkpoint save and restore.");
+      fprintf(output, "%svoid save_checkpoint(const char* filename);\n", INDENT[1]);
+      fprintf(output, "%sbool restore_checkpoint(const char* filename);\n\n", INDENT[1]);
+    }
+
+    if (ACSamplingFlag) {
+      COMMENT(INDENT[1], "Sampled simulation mode switching.");
+      fprintf(output, "%svoid sample_start();\n", INDENT[1]);
+      fprintf(output, "%svoid sample_switch();\n", INDENT[1]);
+      fprintf(output, "%svoid sample_metrics(double* m);\n\n", INDENT[1]);
+    }
+
     fprintf( output, "%svirtual ~%s() {};\n\n", INDENT[1], project_name);
 
     //!Closing class declaration.
     fprintf( output,"%s};\n", INDENT[0] );
     fprintf( output, "#endif  //_%s_H\n\n", upper_project_name);
 
-    fclose( output);
+    ac_output_close(output);
   }
 
   //!Creates Formatted Registers Header File
@@ -1922,7 +2027,7 @@ void CreateRegsHeader() {
     if(( pstorage->type == REG ) && (pstorage->format != NULL )){
 
       if(flag){  //Print this just once.
-        if ( !(output = fopen( filename, "w"))){
+        if ( !(output = ac_output_open(filename))){
           perror("ArchC could not open output file");
           exit(1);
         }
@@ -1990,7 +2095,7 @@ void CreateRegsHeader() {
       fprintf( output,"%svoid change_dump(ostream& output){}\n\n",INDENT[1] );
       fprintf( output,"%svoid reset_log(){}\n\n",INDENT[1] );
       if (ACDelayFlag) {
-        fprintf( output,"%svoid commit_delays(double time)\n",INDENT[1] );
+        fprintf( output,"%svoid commit_delays(ac_log_time time)\n",INDENT[1] );
         fprintf( output,"%s{\n",INDENT[1] );
         for( pfield = pformat->fields; pfield != NULL; pfield = pfield->next) {
           fprintf( output,"%s%s.commit_delays(time);\n", INDENT[2], pfield->name);
@@ -2004,7 +2109,7 @@ void CreateRegsHeader() {
 
   if(!flag){ //We had at last one formatted reg declared.
     fprintf( output, "#endif // %s_FMT_REGS_H\n", upper_project_name);
-    fclose(output);
+    ac_output_close(output);
   }
 }
 
@@ -2025,7 +2130,7 @@ void CreateStatsHeaderTmpl(void){
 
   sprintf(filename, "%s_stats.H.tmpl", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2073,7 +2178,7 @@ void CreateStatsHeaderTmpl(void){
 
   //END OF FILE!
   fprintf(output, "#endif // %s_STATS_H\n", upper_project_name);
-  fclose(output);
+  ac_output_close(output);
 }
 
 //!Create the implementation file for ArchC statistics collection class.
@@ -2090,7 +2195,7 @@ void CreateStatsImplTmpl()
 
   sprintf(filename, "%s_stats.cpp.tmpl", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2126,7 +2231,7 @@ void CreateStatsImplTmpl()
   fprintf(output, "}\n");
 
   //END OF FILE!
-  fclose(output);
+  ac_output_close(output);
 }
 
 /////////////////////////// Create Implementation Functions ////////////////////////////
@@ -2155,7 +2260,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name) {
       sprintf( stage_filename, "%s.cpp", pstage->name);
     }
 
-    if ( !(output = fopen( stage_filename, "w"))){
+    if ( !(output = ac_output_open(stage_filename))){
       perror("ArchC could not open output file");
       exit(1);
     }
@@ -2221,7 +2326,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name) {
 
       if( ACDebugFlag ){
         fprintf( output, "%sextern bool ac_do_trace;\n", INDENT[1]);
-        fprintf( output, "%sextern ofstream trace_file;\n", INDENT[1]);
+        fprintf( output, "%sextern ac_trace_writer trace_file;\n", INDENT[1]);
       }
 
       if( ACABIFlag ){
@@ -2285,7 +2390,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name) {
       fprintf( output, "}\n\n");
     }
 
-    fclose(output);
+    ac_output_close(output);
     free(stage_filename);
   }
 }
@@ -2312,14 +2417,19 @@ void CreateProcessorImpl() {
   filename = (char*) malloc(strlen(project_name)+strlen(".cpp")+1);
   sprintf( filename, "%s.cpp", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
 
   print_comment( output, "Processor Module Implementation File.");
   fprintf( output, "#include  \"%s.H\"\n", project_name);
-  fprintf( output, "#include  \"%s_isa.cpp\"\n\n", project_name);
+  //The behaviors are compiled in this translation unit by the unity build
+  //profile only, see CreateMakefile()
+  fprintf( output, "#ifdef AC_UNITY_BUILD\n");
+  fprintf( output, "#include  \"%s_isa.cpp\"\n", project_name);
+  fprintf( output, "#endif\n\n");
+  fprintf( output, "using namespace %s_parms;\n\n", project_name);
 
   if( ACVerifyFlag ){
     fprintf( output, "#include  \"ac_msgbuf.H\"\n");
@@ -2332,7 +2442,7 @@ void CreateProcessorImpl() {
   fprintf( output, "void %s::behavior() {\n\n", project_name);
   if( ACDebugFlag ){
     fprintf( output, "%sextern bool ac_do_trace;\n", INDENT[1]);
-    fprintf( output, "%sextern ofstream trace_file;\n", INDENT[1]);
+    fprintf( output, "%sextern ac_trace_writer trace_file;\n", INDENT[1]);
   }
   fprintf( output, "%sunsigned ins_id;\n", INDENT[1]);
 
@@ -2525,14 +2635,26 @@ void CreateProcessorImpl() {
       	}
           }
 
+  if (ACProfileFlag) {
+    fprintf(output, "%sextern char* appfilename;\n", INDENT[1]);
+    fprintf(output, "%sif (ac_profile_file) profiler.enable(appfilename, ac_profile_file);\n", INDENT[1]);
+  }
+
   fprintf(output, "%sset_args(ac_argc, ac_argv);\n", INDENT[1]);
   fprintf(output, "#ifdef AC_VERIFY\n");
   fprintf(output, "%sset_queue(av[0]);\n", INDENT[1]);
   fprintf(output, "#endif\n\n");
   fprintf(output, "%sac_pc = ac_start_addr;\n", INDENT[1]);
   fprintf(output, "%sISA._behavior_begin();\n", INDENT[1]);
+  if (ACCheckpointFlag)
+    fprintf(output, "%sif (ac_checkpoint_restore_file && !restore_checkpoint(ac_checkpoint_restore_file)) exit(EXIT_FAILURE);\n", INDENT[1]);
+  if (ACSamplingFlag)
+    fprintf(output, "%sif (ac_sample_spec) sample_start();\n", INDENT[1]);
   fprintf(output, "%scerr << \"ArchC: -------------------- Starting Simulation --------------------\" << endl;\n", INDENT[1]);
-  fprintf(output, "%sInitStat();\n\n", INDENT[1]);
+  fprintf(output, "%sInitStat();\n", INDENT[1]);
+  if (ACPhaseTimersFlag)
+    fprintf(output, "%sphase_timer.start(name());\n", INDENT[1]);
+  fprintf(output, "\n");
 
   fprintf(output, "%ssignal(SIGINT, sigint_handler);\n", INDENT[1]);
   fprintf(output, "%ssignal(SIGTERM, sigint_handler);\n", INDENT[1]);
@@ -2555,6 +2677,7 @@ void CreateProcessorImpl() {
 
   fprintf(output, "%sextern char* appfilename;\n", INDENT[1]);
   fprintf(output, "%sac_init_opt( ac, av);\n", INDENT[1]);
+  fprintf(output, "%sac_batch_start( ac, av);\n", INDENT[1]);
   fprintf(output, "%sac_init_app( ac, av);\n", INDENT[1]);
   fprintf(output, "%sAPP_MEM->load(appfilename);\n", INDENT[1]);
 
@@ -2570,6 +2693,9 @@ void CreateProcessorImpl() {
      }
 
 
+  if (ACProfileFlag)
+    fprintf(output, "%sif (ac_profile_file) profiler.enable(appfilename, ac_profile_file);\n", INDENT[1]);
+
   fprintf(output, "%sset_args(ac_argc, ac_argv);\n", INDENT[1]);
   fprintf(output, "#ifdef AC_VERIFY\n");
   fprintf(output, "%sset_queue(av[0]);\n", INDENT[1]);
@@ -2577,8 +2703,15 @@ void CreateProcessorImpl() {
 
   fprintf(output, "%sac_pc = ac_start_addr;\n", INDENT[1]);
   fprintf(output, "%sISA._behavior_begin();\n", INDENT[1]);
+  if (ACCheckpointFlag)
+    fprintf(output, "%sif (ac_checkpoint_restore_file && !restore_checkpoint(ac_checkpoint_restore_file)) exit(EXIT_FAILURE);\n", INDENT[1]);
+  if (ACSamplingFlag)
+    fprintf(output, "%sif (ac_sample_spec) sample_start();\n", INDENT[1]);
   fprintf(output, "%scerr << \"ArchC: -------------------- Starting Simulation --------------------\" << endl;\n", INDENT[1]);
-  fprintf(output, "%sInitStat();\n\n", INDENT[1]);
+  fprintf(output, "%sInitStat();\n", INDENT[1]);
+  if (ACPhaseTimersFlag)
+    fprintf(output, "%sphase_timer.start(name());\n", INDENT[1]);
+  fprintf(output, "\n");
 
   fprintf(output, "%ssignal(SIGINT, sigint_handler);\n", INDENT[1]);
   fprintf(output, "%ssignal(SIGTERM, sigint_handler);\n", INDENT[1]);
@@ -2604,6 +2737,10 @@ void CreateProcessorImpl() {
   fprintf(output, "%sac_stop_flag = 1;\n", INDENT[1]);
   fprintf(output, "%sac_exit_status = status;\n", INDENT[1]);
   fprintf(output, "#ifndef AC_COMPSIM\n");
+  /* The posted writes of the program reach the platform before it stops */
+  for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next)
+    if (pstorage->type == TLM2_NB_PORT)
+      fprintf(output, "%s%s.fence();\n", INDENT[1], pstorage->name);
   fprintf(output, "%sset_stopped();\n", INDENT[1]);
   fprintf(output, "#endif\n");
   fprintf(output, "}\n\n");
@@ -2644,6 +2781,12 @@ void CreateProcessorImpl() {
     fprintf(output, "}\n\n");
   }
 
+  if (ACCheckpointFlag)
+    EmitCheckpointMethods(output);
+
+  if (ACSamplingFlag)
+    EmitSamplingMethods(output);
+
   /* get_ac_pc() */
   fprintf(output, "// Returns ac_pc value\n");
   fprintf(output, "unsigned %s::get_ac_pc() {\n", project_name);
@@ -2661,6 +2804,17 @@ void CreateProcessorImpl() {
   fprintf(output, "void %s::PrintStat() {\n", project_name);
   fprintf(output, "%sac_arch<%s_parms::ac_word, %s_parms::ac_Hword>::PrintStat();\n", INDENT[1], project_name, project_name);
 
+  if (ACProfileFlag)
+    fprintf(output, "%sif (profiler.is_enabled()) profiler.dump();\n", INDENT[1]);
+
+  if (ACSamplingFlag)
+    fprintf(output, "%sif (sampler.is_enabled()) sampler.dump(ac_instr_counter, std::cerr);\n", INDENT[1]);
+
+  if (ACPhaseTimersFlag) {
+    fprintf(output, "%sphase_timer.dump(std::cerr);\n", INDENT[1]);
+    fprintf(output, "%sif (ac_phase_folded_file) ac_phase_timer::dump_folded(ac_phase_folded_file);\n", INDENT[1]);
+  }
+
 
   if (HaveMemHier) {
 	for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next) {
@@ -2689,7 +2843,7 @@ void CreateProcessorImpl() {
   }
 
   //!END OF FILE.
-  fclose(output);
+  ac_output_close(output);
   free(filename);
 }
 
@@ -2720,7 +2874,7 @@ void CreateArchImpl() {
   sprintf(filename, "%s_arch.cpp", project_name);
 
   load_device= storage_list;
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2925,7 +3079,7 @@ void CreateMainTmpl() {
   FILE  *output;
 
   sprintf( description, "This is the main file for the %s ArchC model", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -2950,8 +3104,11 @@ void CreateMainTmpl() {
   COMMENT(INDENT[1],"%sISA simulator", INDENT[1]);
   fprintf( output, "%s%s %s_proc1(\"%s\");\n\n", INDENT[1], project_name, project_name, project_name);
 
+  COMMENT(INDENT[1], "Batch jobs are forked before the trace thread and file exist.");
+  fprintf( output, "%sac_batch_start(ac, av);\n\n", INDENT[1]);
+
   fprintf( output, "#ifdef AC_DEBUG\n");
-  fprintf( output, "%sac_trace(\"%s_proc1.trace\");\n", INDENT[1], project_name);
+  fprintf( output, "%sac_trace(ac_batch_name(\"%s_proc1.trace\"));\n", INDENT[1], project_name);
   fprintf( output, "#endif \n\n");
 
   if (ACGDBIntegrationFlag == 1)
@@ -3010,7 +3167,7 @@ void CreateImplTmpl(){
   int count_fields;
 
   sprintf( filename, "%s_isa.cpp.tmpl", project_name);
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3109,13 +3266,13 @@ void CreateImplTmpl(){
   }
 
   //!END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 
 
   /* ac_isa_init creation starts here */
   /* Name for ISA initialization file. */
   sprintf( initfilename, "%s_isa_init.cpp", project_name);
-  if ( !(output = fopen( initfilename, "w"))){
+  if ( !(output = ac_output_open(initfilename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3280,7 +3437,7 @@ void CreateImplTmpl(){
   fprintf(output, "\n};\n");
 
   //!END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -3297,7 +3454,7 @@ void CreateIntrTLM2Tmpl() {
 
   sprintf(filename, "%s_intr_handlers.cpp.tmpl", project_name);
 
-  if (!(output = fopen( filename, "w"))) {
+  if (!(output = ac_output_open(filename))) {
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3318,7 +3475,7 @@ void CreateIntrTLM2Tmpl() {
   }
 
   //END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 }
 ///Creates the .cpp template file for interrupt handlers.
 void CreateIntrTmpl() {
@@ -3333,7 +3490,7 @@ void CreateIntrTmpl() {
 
   sprintf(filename, "%s_intr_handlers.cpp.tmpl", project_name);
 
-  if (!(output = fopen( filename, "w"))) {
+  if (!(output = ac_output_open(filename))) {
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3354,7 +3511,7 @@ void CreateIntrTmpl() {
   }
 
   //END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 }
 
 
@@ -3371,7 +3528,7 @@ void CreateRegsImpl() {
 
   sprintf(filename, "%s_regs.cpp.tmpl", project_name);
   
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3392,7 +3549,7 @@ void CreateRegsImpl() {
     }
   }
   //END OF FILE.
-  fclose(output);
+  ac_output_close(output);
 }
 
 
@@ -3405,7 +3562,7 @@ void CreateArchSyscallHeader()
 
   snprintf(filename, 50, "%s_syscall.H.tmpl", project_name);
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3444,7 +3601,7 @@ void CreateArchSyscallHeader()
           project_name, project_name, project_name, project_name,
           project_name);
 
-  fclose( output);
+  ac_output_close(output);
 }
 
 
@@ -3465,7 +3622,7 @@ void CreateIntrTLM2Header() {
 
   sprintf(filename, "%s_intr_handlers.H", project_name);
 
-  if (!(output = fopen( filename, "w"))) {
+  if (!(output = ac_output_open(filename))) {
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3496,7 +3653,7 @@ void CreateIntrTLM2Header() {
   fprintf(output, "#endif // _%s_INTR_HANDLERS_H\n", upper_project_name);
 
   //END OF FILE
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -3519,7 +3676,7 @@ void CreateIntrHeader() {
 
   sprintf(filename, "%s_intr_handlers.H", project_name);
 
-  if (!(output = fopen( filename, "w"))) {
+  if (!(output = ac_output_open(filename))) {
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3549,7 +3706,7 @@ void CreateIntrHeader() {
   fprintf(output, "#endif // _%s_INTR_HANDLERS_H\n", upper_project_name);
 
   //END OF FILE
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -3567,7 +3724,7 @@ void CreateIntrTLM2MacrosHeader() {
 
   sprintf(filename, "%s_ih_bhv_macros.H", project_name);
 
-  if (!(output = fopen( filename, "w"))) {
+  if (!(output = ac_output_open(filename))) {
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3583,7 +3740,7 @@ void CreateIntrTLM2MacrosHeader() {
   fprintf(output, "#endif // _%s_IH_BHV_MACROS_H\n", upper_project_name);
 
   //END OF FILE
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -3600,7 +3757,7 @@ void CreateIntrMacrosHeader() {
 
   sprintf(filename, "%s_ih_bhv_macros.H", project_name);
 
-  if (!(output = fopen( filename, "w"))) {
+  if (!(output = ac_output_open(filename))) {
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3616,7 +3773,7 @@ void CreateIntrMacrosHeader() {
   fprintf(output, "#endif // _%s_IH_BHV_MACROS_H\n", upper_project_name);
 
   //END OF FILE
-  fclose(output);
+  ac_output_close(output);
 
 }
 
@@ -3644,7 +3801,7 @@ void CreateMakefile(){
   FILE *output;
   char filename[] = "Makefile.archc";
 
-  if ( !(output = fopen( filename, "w"))){
+  if ( !(output = ac_output_open(filename))){
     perror("ArchC could not open output file");
     exit(1);
   }
@@ -3697,8 +3854,9 @@ void CreateMakefile(){
   fprintf( output, "OPT :=  %s\n", OPT_FLAGS);
   fprintf( output, "DEBUG :=  %s\n", DEBUG_FLAGS);
   fprintf( output, "OTHER :=  %s\n", OTHER_FLAGS);
-  fprintf( output, "CFLAGS := $(DEBUG) $(OPT) $(OTHER) %s\n",
-           (ACGDBIntegrationFlag) ? "-DUSE_GDB" : "" );
+  fprintf( output, "CFLAGS := $(DEBUG) $(OPT) $(OTHER) %s%s\n",
+           (ACGDBIntegrationFlag) ? "-DUSE_GDB " : "",
+           (ACPhaseTimersFlag) ? "-DAC_PHASE_TIMERS" : "" );
 
   fprintf( output, "\n");
 
@@ -3706,6 +3864,35 @@ void CreateMakefile(){
 
   fprintf( output, "\n");
 
+  //Build profiles: only the processor module includes the behaviors
+  if( !stage_list && !pipe_list ){
+    COMMENT_MAKE("Build profile, PROFILE=<name> on the make command line:");
+    COMMENT_MAKE("  split: the ISA behaviors are compiled apart from the processor module, so");
+    COMMENT_MAKE("         editing one does not rebuild the other and both build in parallel");
+    COMMENT_MAKE("  unity: the behaviors are included in the processor module, so they can be");
+    COMMENT_MAKE("         inlined in the simulation loop (fastest simulator, slowest rebuild)");
+    COMMENT_MAKE("  lto:   split, optimized across translation units at link time");
+    fprintf( output, "PROFILE ?= split\n\n");
+    fprintf( output, "ifeq ($(PROFILE),unity)\n");
+    fprintf( output, "CFLAGS += -DAC_UNITY_BUILD\n");
+    fprintf( output, "else\n");
+    fprintf( output, "ISASRCS := $(MODULE)_isa.cpp\n");
+    fprintf( output, "endif\n");
+    fprintf( output, "ifeq ($(PROFILE),lto)\n");
+    fprintf( output, "CFLAGS += -flto\n");
+    fprintf( output, "endif\n\n");
+
+    COMMENT_MAKE("Behaviors may also be split by format or instruction group into more files,");
+    COMMENT_MAKE("each including $(MODULE)_isa.H and $(MODULE)_bhv_macros.H");
+    fprintf( output, "ISASRCS += $(filter-out $(MODULE)_isa_init.cpp, $(wildcard $(MODULE)_isa_*.cpp))\n\n");
+
+    COMMENT_MAKE("Objects built with another profile are rebuilt");
+    fprintf( output, "PROFILE_STAMP := .ac_build_profile\n");
+    fprintf( output, "$(shell echo $(PROFILE) | cmp -s - $(PROFILE_STAMP) || echo $(PROFILE) > $(PROFILE_STAMP))\n\n");
+  }
+
+  ac_make_jobs(output);
+
   //Declaring ACSRCS variable
 
   COMMENT_MAKE("These are the source files automatically generated by ArchC, that must appear in the SRCS variable");
@@ -3815,7 +4002,7 @@ void CreateMakefile(){
   //Declaring FILESHEAD variable
   COMMENT_MAKE("These are the headers files provided by ArchC");
   COMMENT_MAKE("They are stored in the archc/include directory");
-  fprintf( output, "ACFILESHEAD := $(ACFILES:.cpp=.H) ac_decoder_rt.H ac_module.H ac_storage.H ac_utils.H ac_regbank.H ac_debug_model.H ac_sighandlers.H ac_ptr.H ac_memport.H ac_arch.H ac_arch_dec_if.H ac_arch_ref.H ");
+  fprintf( output, "ACFILESHEAD := $(ACFILES:.cpp=.H) ac_decoder_rt.H ac_module.H ac_storage.H ac_utils.H ac_trace.H ac_regbank.H ac_debug_model.H ac_sighandlers.H ac_ptr.H ac_memport.H ac_arch.H ac_arch_dec_if.H ac_arch_ref.H ");
   if (ACABIFlag)
     fprintf(output, "ac_syscall.H ");
   if (HaveTLMPorts)
@@ -3832,12 +4019,20 @@ void CreateMakefile(){
       fprintf(output, "ac_tlm_protocol.H ");
   if (ACStatsFlag)
     fprintf(output, "ac_stats.H ac_stats_base.H ");
+  if (ACProfileFlag)
+    fprintf(output, "ac_profiler.H ");
+  if (ACCheckpointFlag)
+    fprintf(output, "ac_checkpoint.H ");
+  if (ACSamplingFlag)
+    fprintf(output, "ac_sampler.H ");
+  if (ACDecCacheFlag)
+    fprintf(output, "ac_predecode.H ");
   fprintf(output, "\n\n");
 
   //Declaring SRCS variable
-  //Note: Removed $(MODULE)_isa.cpp, added as include inside $(MODULE).cpp
+  //Note: $(MODULE)_isa.cpp is in ISASRCS, or included inside $(MODULE).cpp by the unity profile
   COMMENT_MAKE("These are the source files provided by the user + ArchC sources");
-  fprintf( output, "SRCS := main.cpp $(ACSRCS) $(ACFILES) %s",
+  fprintf( output, "SRCS := main.cpp $(ACSRCS) $(ISASRCS) $(ACFILES) %s",
            (ACGDBIntegrationFlag)?"$(MODULE)_gdb_funcs.cpp":""); 
 
   if (ACABIFlag)
@@ -3871,7 +4066,16 @@ void CreateMakefile(){
 
   fprintf( output, "$(EXE): $(OBJS) %s\n",
            (strlen(SYSTEMC_PATH) > 2) ? "$(SYSTEMC)/lib-$(TARGET_ARCH)/libsystemc.a" : "");
-  fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) $(LIB_DIR) -o $@ $(OBJS) $(LIBS) 2>&1 | c++filt\n\n");
+  fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) $(LIB_DIR) -o $@ $(OBJS) $(LIBS) 2>&1 | c++filt\n");
+  ac_make_compile_report(output);
+
+  COMMENT_MAKE("ArchC only rewrites the generated files whose contents changed, and the");
+  COMMENT_MAKE("dependencies of each object are tracked by the compiler, so only the objects");
+  COMMENT_MAKE("including a changed file are rebuilt");
+  fprintf( output, "DEPFLAGS := -MMD -MP\n");
+  fprintf( output, "-include $(OBJS:.o=.d)\n\n");
+  if( !stage_list && !pipe_list )
+    fprintf( output, "$(OBJS): $(PROFILE_STAMP)\n\n");
 
   COMMENT_MAKE("Copy from template if main.cpp not exist");
   fprintf(output, "main.cpp:\n");
@@ -3905,14 +4109,13 @@ void CreateMakefile(){
          fprintf( output, "\tcp %s_intr_handlers.cpp.tmpl %s_intr_handlers.cpp\n\n", project_name, project_name);
      }
 
-  fprintf( output, ".cpp.o:\n");
-  fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) -c $<\n\n");
+  ac_make_timed_rule(output, "$(DEPFLAGS) ");
 
   fprintf( output, ".cc.o:\n");
   fprintf( output, "\t$(CC) $(CFLAGS) $(INC_DIR) -c $<\n\n");
 
   fprintf( output, "clean:\n");
-  fprintf( output, "\trm -f $(OBJS) *~ $(EXE) core *.o \n\n");
+  fprintf( output, "\trm -f $(OBJS) $(OBJS:.o=.d) *~ $(EXE) core *.o $(COMPILE_TIMES) .ac_build_profile\n\n");
 
   fprintf( output, "model_clean:\n");
   fprintf( output, "\trm -f $(ACSRCS) $(ACHEAD) $(ACINCS) $(ACFILESHEAD) $(ACFILES) *.tmpl loader.ac \n\n");
@@ -4384,8 +4587,8 @@ void EmitUpdateMethod( FILE *output){
   fprintf( output, "%sif(!ac_wait_sig){\n", INDENT[1]);
   if( ACDelayFlag ){
     for( pstorage = storage_list; pstorage!= NULL; pstorage = pstorage->next )
-      fprintf( output, "%s%s.commit_delays( (double)ac_cycle_counter );\n", INDENT[2], pstorage->name);
-    fprintf( output, "%sac_pc.commit_delays(  (double)ac_cycle_counter );\n", INDENT[2]);
+      fprintf( output, "%s%s.commit_delays( ac_cycle_counter );\n", INDENT[2], pstorage->name);
+    fprintf( output, "%sac_pc.commit_delays( ac_cycle_counter );\n", INDENT[2]);
 
     fprintf( output, "%sif(!ac_parallel_sig)\n", INDENT[2]);
     fprintf( output, "%sac_cycle_counter+=1;\n", INDENT[3]);
@@ -4424,7 +4627,11 @@ void EmitUpdateMethod( FILE *output){
 
     fprintf( output, "%selse {\n", INDENT[2]);
     fprintf( output, "%sinstr_in_batch = 0;\n", INDENT[3]);
+    if( ACPhaseTimersFlag )
+      fprintf( output, "%sphase_timer.enter(ac_phase_timer::WAIT);\n", INDENT[3]);
     fprintf( output, "%swait(1, SC_NS);\n", INDENT[3]);
+    if( ACPhaseTimersFlag )
+      fprintf( output, "%sphase_timer.enter(ac_phase_timer::OTHER);\n", INDENT[3]);
     fprintf( output, "%s}\n", INDENT[2]);
 
     fprintf(output, "%s}\n\n", INDENT[1]);
@@ -4439,6 +4646,8 @@ void EmitUpdateMethod( FILE *output){
   \brief Used by EmitProcessorBhv, EmitMultCycleProcessorBhv and CreateStgImpl functions      */
 /***************************************/
 void EmitDecodification( FILE *output, int base_indent){
+  extern ac_stg_list *stage_list;
+  extern ac_pipe_list *pipe_list;
 
   extern int wordsize, fetchsize, HaveMemHier;
   extern char* project_name;
@@ -4462,6 +4671,9 @@ void EmitDecodification( FILE *output, int base_indent){
     fprintf( output, "%s}\n", INDENT[base_indent]);
   }*/
 
+  if( ACPhaseTimersFlag )
+    fprintf( output, "%sphase_timer.enter(ac_phase_timer::DECODE);\n", INDENT[base_indent]);
+
   if( ACDecCacheFlag ){
     fprintf( output, "%sins_cache = (DEC_CACHE+decode_pc);\n", INDENT[base_indent]);
     fprintf( output, "%sif ( !ins_cache->valid ){\n", INDENT[base_indent]);
@@ -4492,14 +4704,24 @@ void EmitDecodification( FILE *output, int base_indent){
     /*   } */
 
   if( ACDecCacheFlag ){
-    fprintf( output, "%sins_cache->instr_p = new ac_instr<%s_parms::AC_DEC_FIELD_NUMBER>((ISA.decoder)->Decode(reinterpret_cast<unsigned char*>(buffer), quant));\n", INDENT[base_indent+1], project_name);
+    //Entries invalidated by a write to the code keep their instruction object
+    fprintf( output, "%sif (!ins_cache->instr_p)\n", INDENT[base_indent+1]);
+    fprintf( output, "%sins_cache->instr_p = new ac_instr<%s_parms::AC_DEC_FIELD_NUMBER>();\n", INDENT[base_indent+2], project_name);
+    fprintf( output, "%selse\n", INDENT[base_indent+1]);
+    fprintf( output, "%s*(ins_cache->instr_p) = ac_instr<%s_parms::AC_DEC_FIELD_NUMBER>();\n", INDENT[base_indent+2], project_name);
+    fprintf( output, "%s(ISA.decoder)->Decode(reinterpret_cast<unsigned char*>(buffer), quant, ins_cache->instr_p->data());\n", INDENT[base_indent+1]);
     fprintf( output, "%sins_cache->valid = 1;\n", INDENT[base_indent+1]);
+    if( !stage_list && !pipe_list ){
+      fprintf( output, "%sins_cache->hooked = hooks.hooked(decode_pc, ins_cache->instr_p->get(IDENT));\n", INDENT[base_indent+1]);
+      fprintf( output, "%sac_code_pages[decode_pc >> AC_CODE_PAGE_BITS] = 1;\n", INDENT[base_indent+1]);
+      fprintf( output, "%sac_code_pages[(decode_pc + %s_parms::AC_MAX_BUFFER - 1) >> AC_CODE_PAGE_BITS] = 1;\n", INDENT[base_indent+1], project_name);
+    }
     fprintf( output, "%s}\n", INDENT[base_indent]);
     fprintf( output, "%sinstr_vec = ins_cache->instr_p;\n", INDENT[base_indent]);
   }
   else{
-    fprintf( output, "%sinstr_dec = (ISA.decoder)->Decode(reinterpret_cast<unsigned char*>(buffer), quant);\n", INDENT[base_indent]);
-    fprintf( output, "%sinstr_vec = new ac_instr<%s_parms::AC_DEC_FIELD_NUMBER>( instr_dec);\n", INDENT[base_indent], project_name);
+    fprintf( output, "%sinstr_vec = new ac_instr<%s_parms::AC_DEC_FIELD_NUMBER>();\n", INDENT[base_indent], project_name);
+    fprintf( output, "%s(ISA.decoder)->Decode(reinterpret_cast<unsigned char*>(buffer), quant, instr_vec->data());\n", INDENT[base_indent]);
   }
 
   //Checking if it is a valid instruction
@@ -4536,6 +4758,9 @@ void EmitInstrExec( FILE *output, int base_indent){
   if( ACGDBIntegrationFlag )
     fprintf( output, "%sif (gdbstub && gdbstub->stop(decode_pc)) gdbstub->process_bp();\n\n", INDENT[base_indent]);
 
+  if( ACPhaseTimersFlag )
+    fprintf( output, "%sphase_timer.enter(ac_phase_timer::BEHAVIOR);\n", INDENT[base_indent]);
+
   fprintf( output, "%sac_pc = decode_pc;\n\n", INDENT[base_indent]);
 
   fprintf(output, "%sISA.cur_instr_id = ins_id;\n", INDENT[base_indent]);
@@ -4605,6 +4830,16 @@ void EmitInstrExec( FILE *output, int base_indent){
     fprintf( output, "%s}\n", INDENT[base_indent]);
   }
 
+  if( ACProfileFlag ){
+    fprintf( output, "%sif((!ac_annul_sig) && profiler.is_enabled())\n", INDENT[base_indent]);
+    fprintf( output, "%sprofiler.count(decode_pc, ISA.get_size(), ISA.get_cycles());\n", INDENT[base_indent+1]);
+  }
+
+  if( ACSamplingFlag ){
+    fprintf( output, "%sif((!ac_annul_sig) && sampler.is_detailed())\n", INDENT[base_indent]);
+    fprintf( output, "%ssampler.count_cycles(ISA.get_cycles());\n", INDENT[base_indent+1]);
+  }
+
   if( ACDebugFlag ){
     fprintf( output, "%sif( ac_do_trace != 0 ) \n", INDENT[base_indent]);
     fprintf( output, PRINT_TRACE, INDENT[base_indent+1]);
@@ -4629,6 +4864,9 @@ void EmitInstrExec( FILE *output, int base_indent){
 /***************************************/
 void EmitFetchInit( FILE *output, int base_indent){
   extern int HaveMultiCycleIns;
+  extern ac_stg_list *stage_list;
+  extern ac_pipe_list *pipe_list;
+  extern char *project_name;
 
   fprintf(output, "%sbhv_pc = ac_pc;\n", INDENT[base_indent]);
 
@@ -4658,9 +4896,20 @@ void EmitFetchInit( FILE *output, int base_indent){
   fprintf( output, "%sdecode_pc = ac_pc;\n", INDENT[base_indent+2]);
   if(ACABIFlag)
     fprintf( output, "%sISA.syscall.set_prog_args(argc, argv);\n", INDENT[3]);
+  if(ACABIFlag && !stage_list && !pipe_list)
+    fprintf( output, "%sISA.syscall.set_native_hooks();\n", INDENT[3]);
   fprintf( output, "%sstart_up=0;\n", INDENT[base_indent+2]);
   if( ACDecCacheFlag )
     fprintf( output, "%sinit_dec_cache();\n", INDENT[base_indent+2]);
+  if( ACDecCacheFlag && !stage_list && !pipe_list ){
+    fprintf( output, "%sif (ac_predecode_threads) {\n", INDENT[base_indent+2]);
+    fprintf( output, "%sac_predecode<%s_parms::ac_word>(ISA.decoder, ac_text_segments, ac_mt_endian, %s_parms::AC_MAX_BUFFER, DEC_CACHE, dec_cache_size, ac_code_pages, ac_predecode_threads);\n", INDENT[base_indent+3], project_name, project_name);
+    fprintf( output, "%sstd::vector<ac_text_segment>().swap(ac_text_segments);\n", INDENT[base_indent+3]);
+    fprintf( output, "%s}\n", INDENT[base_indent+2]);
+    //Pre-decoded instructions are flagged here
+    fprintf( output, "%sif (hooks.any())\n", INDENT[base_indent+2]);
+    fprintf( output, "%shooks_changed();\n", INDENT[base_indent+3]);
+  }
   fprintf( output, "%s}\n", INDENT[base_indent+1]);
 
   fprintf( output, "%selse{ \n", INDENT[base_indent+1]);
@@ -4684,9 +4933,17 @@ void EmitProcessorBhv( FILE *output){
 
   EmitFetchInit(output, 1);
   EmitDecodification(output, 2);
-  EmitInstrExec(output, 2);
+
+  //Instrumentation hooks
+  fprintf( output, "%sif (!(%s && hooks.run(decode_pc, ins_id))) {\n", INDENT[2], HOOKED_INSTR);
+  EmitInstrExec(output, 3);
+  fprintf( output, "%s}\n", INDENT[2]);
 
   fprintf( output, "%sif ((!ac_wait_sig) && (!ac_annul_sig)) ac_instr_counter+=1;\n", INDENT[2]);
+  if( ACCheckpointFlag )
+    EmitCheckpointSave(output, 2);
+  if( ACSamplingFlag )
+    fprintf( output, "%sif (sampler.is_enabled() && ac_instr_counter == sampler.next_switch()) sample_switch();\n", INDENT[2]);
   fprintf( output, "%sac_annul_sig = 0;\n", INDENT[2]);
   if (ACVerboseFlag || ACVerifyFlag || ACVerifyTimedFlag)
     fprintf( output, "%sbhv_done.write(1);\n", INDENT[2]);
@@ -4723,6 +4980,11 @@ void EmitProcessorBhv_ABI( FILE *output){
   fprintf( output, "%sdefault:\n\n", INDENT[2]);
 
   EmitDecodification(output, 2);
+
+  //Instrumentation hooks, among them the library routines run on the host
+  fprintf( output, "%sif (%s && hooks.run(decode_pc, ins_id))\n", INDENT[3], HOOKED_INSTR);
+  fprintf( output, "%sbreak;\n\n", INDENT[4]);
+
   EmitInstrExec(output, 3);
 
   //Closing default case.
@@ -4732,6 +4994,10 @@ void EmitProcessorBhv_ABI( FILE *output){
   fprintf( output, "%s}\n", INDENT[2]);
 
   fprintf( output, "%sif ((!ac_wait_sig) && (!ac_annul_sig)) ac_instr_counter+=1;\n", INDENT[2]);
+  if( ACCheckpointFlag )
+    EmitCheckpointSave(output, 2);
+  if( ACSamplingFlag )
+    fprintf( output, "%sif (sampler.is_enabled() && ac_instr_counter == sampler.next_switch()) sample_switch();\n", INDENT[2]);
   fprintf( output, "%sac_annul_sig = 0;\n", INDENT[2]);
   if (ACVerboseFlag || ACVerifyFlag || ACVerifyTimedFlag)
     fprintf( output, "%sdone.write(1);\n", INDENT[2]);
@@ -4771,7 +5037,7 @@ void EmitMultiCycleProcessorBhv( FILE *output){
 
   if( ACDebugFlag ){
     fprintf( output, "%sif( ac_do_trace != 0 ) \n", INDENT[3]);
-    fprintf( output, PRINT_TRACE, INDENT[4]);
+    fprintf( output, "%strace_file.instr(decode_pc, 0);\n", INDENT[4]);
   }
 
   if( ACStatsFlag ){
@@ -4800,6 +5066,228 @@ void EmitMultiCycleProcessorBhv( FILE *output){
   fprintf( output, "}\n\n");
 }
 
+/**************************************/
+/*!  Emits the check that saves a checkpoint after the
+  instruction count given with --checkpoint-save
+  \brief Used by EmitProcessorBhv and EmitProcessorBhv_ABI      */
+/***************************************/
+void EmitCheckpointSave( FILE *output, int base_indent){
+
+  fprintf( output, "%sif (ac_checkpoint_save_file && ac_instr_counter == ac_checkpoint_save_at) {\n", INDENT[base_indent]);
+  fprintf( output, "%ssave_checkpoint(ac_checkpoint_save_file);\n", INDENT[base_indent+1]);
+  fprintf( output, "%sac_checkpoint_save_file = 0;\n", INDENT[base_indent+1]);
+  fprintf( output, "%s}\n", INDENT[base_indent]);
+}
+
+/**************************************/
+/*!  Emits save/restore of every storage device to/from an ac_checkpoint.
+  \brief Used by EmitCheckpointMethods      */
+/***************************************/
+static void EmitCheckpointStorage( FILE *output, const char *method){
+
+  extern ac_sto_list *storage_list;
+  extern ac_dec_format *format_reg_list;
+  extern char *project_name;
+  ac_sto_list *pstorage;
+  ac_dec_format *pformat;
+  ac_dec_field *pfield;
+
+  fprintf(output, "%scp.section(\"arch\");\n", INDENT[1]);
+  fprintf(output, "%sac_arch<%s_parms::ac_word, %s_parms::ac_Hword>::%s(cp);\n", INDENT[1], project_name, project_name, method);
+  fprintf(output, "%scp.section(\"ac_pc\");\n", INDENT[1]);
+  fprintf(output, "%sac_pc.%s(cp);\n", INDENT[1], method);
+
+  for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next) {
+    switch (pstorage->type) {
+    case REG:
+      fprintf(output, "%scp.section(\"%s\");\n", INDENT[1], pstorage->name);
+      if (pstorage->format != NULL) {
+        for (pformat = format_reg_list; pformat != NULL && strcmp(pformat->name, pstorage->format); pformat = pformat->next);
+        for (pfield = pformat ? pformat->fields : NULL; pfield != NULL; pfield = pfield->next)
+          fprintf(output, "%s%s.%s.%s(cp);\n", INDENT[1], pstorage->name, pfield->name, method);
+      }
+      else
+        fprintf(output, "%s%s.%s(cp);\n", INDENT[1], pstorage->name, method);
+      break;
+    case REGBANK:
+      fprintf(output, "%scp.section(\"%s\");\n", INDENT[1], pstorage->name);
+      fprintf(output, "%s%s.%s(cp);\n", INDENT[1], pstorage->name, method);
+      break;
+    case TLM_PORT:
+    case TLM2_PORT:
+    case TLM2_NB_PORT:
+      //External devices keep their own state.
+      break;
+    default:
+      fprintf(output, "%scp.section(\"%s\");\n", INDENT[1], pstorage->name);
+      fprintf(output, "%s%s_stg.%s(cp);\n", INDENT[1], pstorage->name, method);
+      break;
+    }
+  }
+}
+
+/**************************************/
+/*!  Emits save_checkpoint() and restore_checkpoint()
+  \brief Used by CreateProcessorImpl function      */
+/***************************************/
+void EmitCheckpointMethods( FILE *output){
+
+  extern char *project_name;
+
+  fprintf(output, "// Saves the processor, memory and open file state.\n");
+  fprintf(output, "void %s::save_checkpoint(const char* filename) {\n", project_name);
+  fprintf(output, "%sac_checkpoint cp;\n\n", INDENT[1]);
+  fprintf(output, "%sif (!cp.create(filename))\n", INDENT[1]);
+  fprintf(output, "%sreturn;\n", INDENT[2]);
+  EmitCheckpointStorage(output, "save");
+  fprintf(output, "%scp.section(\"files\");\n", INDENT[1]);
+  fprintf(output, "%scp.put_files();\n", INDENT[1]);
+  fprintf(output, "%sif (cp.close())\n", INDENT[1]);
+  fprintf(output, "%scerr << \"ArchC: Checkpoint saved to \" << filename << \" after \" << ac_instr_counter << \" instructions.\" << endl;\n", INDENT[2]);
+  fprintf(output, "%selse\n", INDENT[1]);
+  fprintf(output, "%scerr << \"ArchC: Could not write checkpoint \" << filename << endl;\n", INDENT[2]);
+  fprintf(output, "}\n\n");
+
+  fprintf(output, "// Restores the state saved by save_checkpoint().\n");
+  fprintf(output, "bool %s::restore_checkpoint(const char* filename) {\n", project_name);
+  fprintf(output, "%sac_checkpoint cp;\n\n", INDENT[1]);
+  fprintf(output, "%sif (!cp.open(filename))\n", INDENT[1]);
+  fprintf(output, "%sreturn false;\n", INDENT[2]);
+  EmitCheckpointStorage(output, "restore");
+  fprintf(output, "%scp.section(\"files\");\n", INDENT[1]);
+  fprintf(output, "%scp.get_files();\n", INDENT[1]);
+  fprintf(output, "%sif (!cp.close())\n", INDENT[1]);
+  fprintf(output, "%sreturn false;\n", INDENT[2]);
+  fprintf(output, "%scerr << \"ArchC: Restored checkpoint \" << filename << \" at \" << ac_instr_counter << \" instructions.\" << endl;\n", INDENT[1]);
+  fprintf(output, "%sreturn true;\n", INDENT[1]);
+  fprintf(output, "}\n\n");
+}
+
+/**************************************/
+/*!  Emits sample_start(), sample_switch() and sample_metrics()
+  \brief Used by CreateProcessorImpl function      */
+/***************************************/
+void EmitSamplingMethods( FILE *output){
+
+  extern ac_sto_list *storage_list;
+  extern char *project_name;
+  extern int HaveMemHier;
+  ac_sto_list *pstorage;
+  int n = 1;
+
+  fprintf(output, "// Starts sampled simulation with the --sample parameters.\n");
+  fprintf(output, "void %s::sample_start() {\n", project_name);
+  fprintf(output, "%sif (!sampler.enable(ac_sample_spec))\n", INDENT[1]);
+  fprintf(output, "%sexit(EXIT_FAILURE);\n", INDENT[2]);
+  fprintf(output, "%ssampler.add_metric(\"cycles\");\n", INDENT[1]);
+  for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next) {
+    switch (pstorage->type) {
+    case CACHE:
+    case ICACHE:
+    case DCACHE:
+      if (HaveMemHier) {
+        fprintf(output, "%ssampler.add_metric(\"%s misses\");\n", INDENT[1], pstorage->name);
+        n++;
+      }
+      break;
+    case TLM_PORT:
+    case TLM2_PORT:
+    case TLM2_NB_PORT:
+      fprintf(output, "%ssampler.add_metric(\"%s time (ns)\");\n", INDENT[1], pstorage->name);
+      n++;
+      break;
+    default:
+      break;
+    }
+  }
+  fprintf(output, "%ssample_switch();\n", INDENT[1]);
+  fprintf(output, "}\n\n");
+
+  fprintf(output, "// Switches between fast-forward, warmup and measurement.\n");
+  fprintf(output, "void %s::sample_switch() {\n", project_name);
+  fprintf(output, "%sdouble m[%d];\n", INDENT[1], n);
+  fprintf(output, "%sbool was_detailed = sampler.is_detailed();\n\n", INDENT[1]);
+  fprintf(output, "%sif (was_detailed) {\n", INDENT[1]);
+  fprintf(output, "%ssample_metrics(m);\n", INDENT[2]);
+  fprintf(output, "%ssampler.window_end(ac_instr_counter, m);\n", INDENT[2]);
+  fprintf(output, "%s}\n", INDENT[1]);
+  fprintf(output, "%sac_sampler::mode mode = sampler.advance(ac_instr_counter);\n", INDENT[1]);
+  if (HaveMemHier) {
+    for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next)
+      if ((pstorage->type == CACHE || pstorage->type == ICACHE || pstorage->type == DCACHE) && pstorage->level == 0)
+        fprintf(output, "%s%s_if.set_bypass(mode == ac_sampler::FUNCTIONAL);\n", INDENT[1], pstorage->name);
+  }
+  fprintf(output, "%sif (mode == ac_sampler::DETAILED) {\n", INDENT[1]);
+  fprintf(output, "%ssample_metrics(m);\n", INDENT[2]);
+  fprintf(output, "%ssampler.window_begin(ac_instr_counter, m);\n", INDENT[2]);
+  fprintf(output, "%s}\n", INDENT[1]);
+  fprintf(output, "}\n\n");
+
+  fprintf(output, "// Reads the metrics declared in sample_start().\n");
+  fprintf(output, "void %s::sample_metrics(double* m) {\n", project_name);
+  if (HaveMemHier)
+    fprintf(output, "%scache_statistics s;\n", INDENT[1]);
+  fprintf(output, "%sm[0] = sampler.get_cycles();\n", INDENT[1]);
+  n = 1;
+  for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next) {
+    switch (pstorage->type) {
+    case CACHE:
+    case ICACHE:
+    case DCACHE:
+      if (HaveMemHier) {
+        fprintf(output, "%s%s.get_statistics(&s);\n", INDENT[1], pstorage->name);
+        fprintf(output, "%sm[%d] = s.read_miss + s.write_miss;\n", INDENT[1], n++);
+      }
+      break;
+    case TLM_PORT:
+    case TLM2_PORT:
+    case TLM2_NB_PORT:
+      fprintf(output, "%sm[%d] = %s.getTotalTime().to_seconds() * 1e9;\n", INDENT[1], n++, pstorage->name);
+      break;
+    default:
+      break;
+    }
+  }
+  fprintf(output, "}\n\n");
+}
+
+/**************************************/
+/*!  Emits the calls that make the writes through the memory
+  ports of the processor invalidate the decoder cache.
+  \brief Used by CreateProcessorHeader function      */
+/***************************************/
+void EmitCodeWatch( FILE *output, int base_indent){
+
+  extern ac_sto_list *storage_list;
+  extern int HaveMemHier;
+  ac_sto_list *pstorage;
+
+  for (pstorage = storage_list; pstorage != NULL; pstorage = pstorage->next) {
+    switch (pstorage->type) {
+    case REG:
+    case REGBANK:
+    case TLM_INTR_PORT:
+    case TLM2_INTR_PORT:
+      break;
+    case CACHE:
+    case ICACHE:
+    case DCACHE:
+      if (!HaveMemHier)
+        fprintf(output, "%s%s.watch_code();\n", INDENT[base_indent], pstorage->name);
+      else if (pstorage->level == 0)
+        fprintf(output, "%s%s_port.watch_code();\n", INDENT[base_indent], pstorage->name);
+      break;
+    case MEM:
+      if (!HaveMemHier)
+        fprintf(output, "%s%s.watch_code();\n", INDENT[base_indent], pstorage->name);
+      break;
+    default:
+      fprintf(output, "%s%s.watch_code();\n", INDENT[base_indent], pstorage->name);
+      break;
+    }
+  }
+}
+
 /**************************************/
 /*!  Emits the define that implements the ABI control
   for pipelined architectures
@@ -4820,7 +5308,7 @@ void EmitPipeABIDefine( FILE *output){
 
   if( ACDebugFlag ){
     fprintf( output, "%sif( ac_do_trace != 0 )\\\n", INDENT[4]);
-    fprintf( output, "%strace_file << hex << decode_pc << dec << endl; \\\n", INDENT[5]);
+    fprintf( output, "%strace_file.instr(decode_pc, 0); \\\n", INDENT[5]);
   }
 
   fprintf( output, "%sISA.syscall.NAME(); \\\n", INDENT[4]);
@@ -4853,9 +5341,12 @@ void EmitABIDefine( FILE *output){
 
   if( ACDebugFlag ){
     fprintf( output, "%sif( ac_do_trace != 0 )\\\n", INDENT[4]);
-    fprintf( output, "%strace_file << hex << decode_pc << dec << endl; \\\n", INDENT[5]);
+    fprintf( output, "%strace_file.instr(decode_pc, 0); \\\n", INDENT[5]);
   }
 
+  if( ACPhaseTimersFlag )
+    fprintf( output, "%sphase_timer.enter(ac_phase_timer::SYSCALL); \\\n", INDENT[4]);
+
   fprintf( output, "%sISA.syscall.NAME(); \\\n", INDENT[4]);
   fprintf( output, "%sbreak;  \\\n", INDENT[3]);
 }
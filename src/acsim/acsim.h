@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include "ac_decoder.h"
 #include "ac_tools_common.h"
+#include "ac_output.h"
 
 /*Defining indentation */
 #define INDENT0  ""
@@ -97,6 +98,10 @@ enum _ac_cmd_options {
   OPVersion,
   OPGDBIntegration,
   OPWait,
+  OPProfile,
+  OPCheckpoint,
+  OPSampling,
+  OPPhaseTimers,
   ACNumberOfOptions
 };
 
@@ -203,6 +208,10 @@ void EmitProcessorBhv_ABI( FILE *output);         //!< Emit processor behavior f
 void EmitABIAddrList( FILE *output, int base_indent);           //!< Emit the calls for macros containing the list o address used for system calls
 void EmitABIDefine( FILE *output);                //!< Emit the define that implements the ABI control for non-pipelined architectures
 void EmitPipeABIDefine( FILE *output);            //!< Emit the define that implements the ABI control for pipelined architectures
+void EmitCheckpointSave( FILE *output, int base_indent); //!< Emit the check that saves a checkpoint at a given instruction count
+void EmitCheckpointMethods( FILE *output);        //!< Emit save_checkpoint() and restore_checkpoint()
+void EmitSamplingMethods( FILE *output);          //!< Emit the sampled simulation mode switching methods
+void EmitCodeWatch( FILE *output, int base_indent); //!< Emit the registration of the memory ports whose writes invalidate the decoder cache
 void EmitInstrExec(FILE *output, int base_indent);              //!< Emit code for executing an instruction behavior
 void EmitDecodification(FILE *output, int base_indent);         //!< Emit for instruction decodification
 void EmitFetchInit(FILE *output, int base_indent);              //!< Emit code used for initializing fetchs
@@ -0,0 +1,169 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/**
+ * @file      actrace.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   2.2
+ *
+ * @brief     Reader for the binary instruction traces written by
+ *            simulators generated with acsim -g.
+ *
+ *            Converts traces to the text format of older ArchC versions
+ *            (one hexadecimal address per line) or feeds them to simple
+ *            cache models.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "ac_trace.H"
+
+using std::vector;
+
+//! Set associative LRU cache model.
+struct cache_model {
+  unsigned sets, ways, line_bits;
+  vector<unsigned> tags;
+  vector<unsigned long long> stamps;
+  unsigned long long clock, accesses, misses;
+
+  cache_model(unsigned size, unsigned line, unsigned assoc) :
+    sets(size / (line * assoc)), ways(assoc), line_bits(0),
+    tags(sets * assoc, ~0U), stamps(sets * assoc, 0),
+    clock(0), accesses(0), misses(0) {
+    while ((1U << line_bits) < line)
+      line_bits++;
+  }
+
+  void access(unsigned addr) {
+    unsigned line = addr >> line_bits;
+    unsigned base = (line % sets) * ways;
+    unsigned victim = base;
+
+    accesses++;
+    clock++;
+    for (unsigned i = base; i < base + ways; i++) {
+      if (tags[i] == line) {
+        stamps[i] = clock;
+        return;
+      }
+      if (stamps[i] < stamps[victim])
+        victim = i;
+    }
+    misses++;
+    tags[victim] = line;
+    stamps[victim] = clock;
+  }
+
+  void print(const char* name) {
+    printf("%s: %llu accesses, %llu misses (%.2f%%)\n", name, accesses, misses,
+           accesses ? 100.0 * misses / accesses : 0.0);
+  }
+};
+
+static void usage(const char* prog) {
+  fprintf(stderr, "Usage: %s [options] <trace_file>\n\n", prog);
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  --text                  Print one instruction address per line (default)\n");
+  fprintf(stderr, "  --mem                   Also print memory access records\n");
+  fprintf(stderr, "  --stats                 Print instruction, block and memory access counts\n");
+  fprintf(stderr, "  --icache=<size>,<line>,<assoc>  Simulate an instruction cache\n");
+  fprintf(stderr, "  --dcache=<size>,<line>,<assoc>  Simulate a data cache\n");
+  exit(1);
+}
+
+static cache_model* parse_cache(const char* spec) {
+  unsigned size, line, assoc;
+
+  if (sscanf(spec, "%u,%u,%u", &size, &line, &assoc) != 3 ||
+      !size || !line || !assoc || size < line * assoc) {
+    fprintf(stderr, "Invalid cache specification: %s\n", spec);
+    exit(1);
+  }
+  return new cache_model(size, line, assoc);
+}
+
+int main(int argc, char* argv[]) {
+  bool text = false, mem = false, stats = false;
+  cache_model *icache = 0, *dcache = 0;
+  const char* filename = 0;
+  ac_trace_reader reader;
+  ac_trace_record r;
+  unsigned long long instrs = 0, blocks = 0, reads = 0, writes = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--text"))
+      text = true;
+    else if (!strcmp(argv[i], "--mem"))
+      text = mem = true;
+    else if (!strcmp(argv[i], "--stats"))
+      stats = true;
+    else if (!strncmp(argv[i], "--icache=", 9))
+      icache = parse_cache(argv[i] + 9);
+    else if (!strncmp(argv[i], "--dcache=", 9))
+      dcache = parse_cache(argv[i] + 9);
+    else if (argv[i][0] == '-' || filename)
+      usage(argv[0]);
+    else
+      filename = argv[i];
+  }
+
+  if (!filename)
+    usage(argv[0]);
+  if (!stats && !icache && !dcache)
+    text = true;
+
+  if (!reader.open(filename)) {
+    fprintf(stderr, "%s is not an ArchC trace file.\n", filename);
+    return 1;
+  }
+
+  while (reader.next(r)) {
+    if (r.tag == AC_TRACE_BLOCK) {
+      unsigned pc = r.addr;
+      blocks++;
+      instrs += r.count;
+      for (unsigned i = 0; i < r.count; i++, pc += r.size) {
+        if (text)
+          printf("%x\n", pc);
+        if (icache)
+          icache->access(pc);
+      }
+    }
+    else {
+      if (r.tag == AC_TRACE_READ)
+        reads++;
+      else
+        writes++;
+      if (mem)
+        printf("%c %x %u\n", r.tag == AC_TRACE_READ ? 'R' : 'W', r.addr, r.size);
+      if (dcache)
+        dcache->access(r.addr);
+    }
+  }
+
+  if (stats) {
+    printf("Instructions: %llu\n", instrs);
+    printf("Trace blocks: %llu\n", blocks);
+    printf("Average block length: %.2f\n", blocks ? (double) instrs / blocks : 0.0);
+    printf("Memory reads: %llu\n", reads);
+    printf("Memory writes: %llu\n", writes);
+  }
+  if (icache)
+    icache->print("icache");
+  if (dcache)
+    dcache->print("dcache");
+
+  return 0;
+}
@@ -61,7 +61,7 @@ const char* pc_type = "unsigned"; //!< The data type representing the value of a
 const unsigned pipe_maximum_path_length = 7;
 
 // Defining traces and dasm strings
-#define PRINT_TRACE "%strace_file << hex << ap.decode_pc << dec << \"\\n\";\n"
+#define PRINT_TRACE "%strace_file.instr(ap.decode_pc, 0);\n"
 #define PRINT_DASM "%sdasmfile << hex << ap.decode_pc << dec << \": \" << \"(\" << isa.instructions[1 + ins_id].name << \",\" << %s_parms::%s_isa::instructions[1 + ins_id].format << \")\" << endl;\n"
 
 // Command-line options flags
@@ -2830,7 +2830,7 @@ void CreateStgImpl(ac_stg_list* stage_list, char* pipe_name)
    if (ACDebugFlag)
    {
     fprintf(output, "%sextern bool ac_do_trace;\n", INDENT[1]);
-    fprintf(output, "%sextern ofstream trace_file;\n", INDENT[1]);
+    fprintf(output, "%sextern ac_trace_writer trace_file;\n", INDENT[1]);
    }
    if (ACABIFlag)
     fprintf(output, "%sstatic ac_instr_t* the_nop = new ac_instr_t;\n", INDENT[1]);
@@ -3101,7 +3101,7 @@ void CreateProcessorImpl(void)
   if (ACDebugFlag)
   {
    fprintf(output, "%sextern bool ac_do_trace;\n", INDENT[1]);
-   fprintf(output, "%sextern ofstream trace_file;\n", INDENT[1]);
+   fprintf(output, "%sextern ac_trace_writer trace_file;\n", INDENT[1]);
   }
   if (ACVerifyFlag)
   {
@@ -4098,7 +4098,7 @@ void EmitPipeABIDefine(FILE* output)
  if (ACDebugFlag)
  {
   fprintf(output, "%sif (ac_do_trace != 0) \\\n", INDENT[5]);
-  fprintf(output, "%strace_file << hex << ap.decode_pc << dec << endl; \\\n",
+  fprintf(output, "%strace_file.instr(ap.decode_pc, 0); \\\n",
           INDENT[6]);
  }
  fprintf(output, "%ssyscall.NAME(); \\\n", INDENT[5]);
@@ -4127,7 +4127,7 @@ void EmitABIDefine(FILE* output, int base_indent)
  if (ACDebugFlag)
  {
   fprintf(output, "%sif (ac_do_trace != 0) \\\n", INDENT[base_indent + 1]);
-  fprintf(output, "%strace_file << hex << ap.decode_pc << dec << endl; \\\n",
+  fprintf(output, "%strace_file.instr(ap.decode_pc, 0); \\\n",
           INDENT[base_indent + 2]);
  }
  fprintf(output, "%ssyscall.NAME(); \\\n", INDENT[base_indent + 1]);